@@ -0,0 +1,237 @@
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include "problem.h"
+#include "annealing.h"
+#include "parallel.h"
+#include "profile.h"
+#include "pcg_basic.h"
+
+#define MAX(A, B) ((A) > (B) ? (A) : (B))
+
+// Chains buffer their trace rows and append them to the score file in whole
+// blocks, the chain column tells the rows of the chains apart
+#define TRACE_BUFFER_SIZE 65536
+#define TRACE_ROW_SIZE 128
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct
+{
+    void *chromosom;
+    int score;
+}Individual;
+
+typedef struct
+{
+    Problem problem;
+    AnnealingSettings *settings;
+    Individual current;
+    Individual candidate;
+    Individual best;
+    int *history;
+    int lowerBound;
+    int chain;
+    int chainCount;
+    uint64_t seed;
+    uint64_t iteration;
+    uint64_t iterationCount;
+    char *trace; // TRACE_BUFFER_SIZE, only with a score file
+    int traceLength;
+}Context;
+
+static void flushTrace(Context *context)
+{
+    if(context->traceLength == 0)
+        return;
+    pthread_mutex_lock(&trace_mutex);
+    fwrite(context->trace, 1, context->traceLength, context->settings->scoreFile);
+    pthread_mutex_unlock(&trace_mutex);
+    context->traceLength = 0;
+}
+
+static Score calculateAndPrintScore(Context *context, Individual *individual, int cutoff)
+{
+    Score score = context->problem.calculateScore(&context->problem, 
+                                                  individual->chromosom, cutoff);
+    individual->score = score.score;
+    //Chains interleave their iterations so the trace index counts evaluations
+    uint64_t iteration = context->iteration * context->chainCount + context->chain;
+    PROFILE_BEGIN(PHASE_TRACE_IO);
+    if(context->settings->scoreFile)
+    {
+        if(context->traceLength > TRACE_BUFFER_SIZE - TRACE_ROW_SIZE)
+            flushTrace(context);
+        context->traceLength += snprintf(context->trace + context->traceLength, 
+                                         TRACE_ROW_SIZE, "%li, %i, %i, %i, %i, %i\n", 
+                                         iteration, score.score, score.rawScore, 
+                                         score.overlap, score.rejected, context->chain);
+    }
+    if(context->settings->profileFile && context->chain == 0 &&
+       context->iteration % context->settings->profileInterval == 0)
+        profile_printSample(context->settings->profileFile, iteration);
+    PROFILE_END(PHASE_TRACE_IO);
+    if(score.overlap == 0 && !score.rejected && context->best.score > score.score)
+    {
+        memcpy(context->best.chromosom, 
+               individual->chromosom, 
+               context->problem.chromosomSize);
+        context->best.score = score.score;
+    }
+    context->iteration++;
+    return score;
+}
+
+static void printCSVHeader(AnnealingSettings *settings)
+{
+    if(settings->scoreFile)
+        fprintf(settings->scoreFile, "iteration,score,rawScore,overlap,rejected,chain\n");
+    if(settings->profileFile)
+        profile_printSampleHeader(settings->profileFile);
+}
+
+static float temperature(Context *context)
+{
+    AnnealingSettings *settings = context->settings;
+    float progress = (float)context->iteration / context->iterationCount;
+    if(settings->cooling == COOLING_LINEAR)
+        return settings->startTemperature + 
+               (settings->endTemperature - settings->startTemperature) * progress;
+    return settings->startTemperature * 
+           powf(settings->endTemperature / settings->startTemperature, progress);
+}
+
+// Highest score the candidate may have to be accepted. Annealing draws its 
+// random threshold up front, so the cutoff is exact for both rules.
+static int acceptanceLimit(Context *context)
+{
+    AnnealingSettings *settings = context->settings;
+    int current = context->current.score;
+    if(settings->acceptance == ACCEPT_LATE)
+    {
+        int late = context->history[context->iteration % settings->lateAcceptanceLength];
+        return MAX(current, late);
+    }
+    double threshold = -temperature(context) * current * log(1 - pcg32_fraction());
+    return threshold < INT_MAX - current ? current + (int)threshold : INT_MAX;
+}
+
+static void runChain(void *data, int chain)
+{
+    Context *context = (Context *)data + chain;
+    AnnealingSettings *settings = context->settings;
+    Problem *problem = &context->problem;
+    if(context->chainCount > 1)
+        pcg32_srandom(context->seed, chain);
+
+    if(!settings->useSeeds || !problem->seedChromosom ||
+       !problem->seedChromosom(problem, chain, context->current.chromosom))
+        problem->initializeChromosom(problem, context->current.chromosom);
+    calculateAndPrintScore(context, &context->current, INT_MAX);
+    for(int i = 0; i < settings->lateAcceptanceLength; i++)
+        context->history[i] = context->current.score;
+    while(context->iteration < context->iterationCount)
+    {
+        if(settings->stopAtLowerBound && context->best.score <= context->lowerBound)
+            break;
+        uint64_t step = context->iteration;
+        int limit = acceptanceLimit(context);
+        memcpy(context->candidate.chromosom, context->current.chromosom, 
+               problem->chromosomSize);
+        problem->localMove(problem, context->candidate.chromosom);
+        Score score = calculateAndPrintScore(context, &context->candidate, 
+                                             settings->useScoreCutoff ? limit : INT_MAX);
+        if(!score.rejected && score.score <= limit)
+        {
+            Individual tmp = context->current;
+            context->current = context->candidate;
+            context->candidate = tmp;
+        }
+        if(settings->acceptance == ACCEPT_LATE)
+            context->history[step % settings->lateAcceptanceLength] = context->current.score;
+    }
+    if(settings->scoreFile)
+        flushTrace(context);
+}
+
+RunResult annealing_run(Problem *problem, AnnealingSettings *settings)
+{
+    assert(problem->localMove);
+    assert(!settings->profileFile || settings->profileInterval > 0);
+    assert(settings->acceptance != ACCEPT_LATE || settings->lateAcceptanceLength > 0);
+    int chainCount = settings->chainCount ? settings->chainCount : parallel_coreCount();
+    assert(chainCount == 1 || (problem->clone && problem->freeClone));
+    profile_reset();
+    printCSVHeader(settings);
+    int lowerBound = problem->lowerBound ? problem->lowerBound(problem) : 0;
+    uint64_t seed = ((uint64_t)pcg32_random() << 32) | pcg32_random();
+    int historyLength = MAX(settings->lateAcceptanceLength, 1);
+
+    Context *contexts = calloc(chainCount, sizeof (Context));
+    char *chromosomeMemory = malloc(chainCount * 3 * problem->chromosomSize);
+    char *chromosomes = chromosomeMemory;
+    int *history = malloc(chainCount * historyLength * sizeof (int));
+    char *traces = settings->scoreFile ? malloc(chainCount * TRACE_BUFFER_SIZE) : NULL;
+    for(int chain = 0; chain < chainCount; chain++)
+    {
+        uint64_t iterationCount = settings->maxIteration / chainCount;
+        if((uint64_t)chain < settings->maxIteration % chainCount)
+            iterationCount++;
+        Context *context = &contexts[chain];
+        *context = (Context)
+        {
+            .problem = chainCount > 1 ? problem->clone(problem) : *problem,
+            .settings = settings,
+            .current.chromosom = chromosomes,
+            .candidate.chromosom = chromosomes + problem->chromosomSize,
+            .best =
+            {
+                .chromosom = chromosomes + problem->chromosomSize * 2,
+                .score = INT_MAX,
+            },
+            .history = history + chain * historyLength,
+            .lowerBound = lowerBound,
+            .chain = chain,
+            .chainCount = chainCount,
+            .seed = seed,
+            .iterationCount = iterationCount,
+            .trace = traces ? traces + chain * TRACE_BUFFER_SIZE : NULL,
+        };
+        chromosomes += problem->chromosomSize * 3;
+    }
+    parallel_run(chainCount, chainCount, runChain, contexts);
+
+    Context *best = &contexts[0];
+    uint64_t iterations = 0;
+    for(int chain = 0; chain < chainCount; chain++)
+    {
+        if(contexts[chain].best.score < best->best.score)
+            best = &contexts[chain];
+        iterations += contexts[chain].iteration;
+    }
+    if(problem->printChromosom && settings->bestResultFile)
+        problem->printChromosom(problem, best->best.chromosom, 
+                                settings->bestResultFile);
+    if(problem->writeImage && settings->bestImageFile)
+        problem->writeImage(problem, best->best.chromosom, settings->bestImageFile);
+    profile_printSummary(stdout, problem->name);
+    problem_printGap(problem, best->best.score, lowerBound);
+    RunResult result =
+    {
+        .bestScore = best->best.score,
+        .lowerBound = lowerBound,
+        .iterations = iterations,
+    };
+    if(chainCount > 1)
+        for(int chain = 0; chain < chainCount; chain++)
+            problem->freeClone(&contexts[chain].problem);
+    free(chromosomeMemory);
+    free(history);
+    free(traces);
+    free(contexts);
+    return result;
+}
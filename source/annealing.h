@@ -0,0 +1,44 @@
+#ifndef _ANNEALING_H
+#define _ANNEALING_H
+
+#include "problem.h"
+
+typedef enum
+{
+    ACCEPT_ANNEALING,
+    ACCEPT_LATE
+}Acceptance;
+
+typedef enum
+{
+    COOLING_EXPONENTIAL,
+    COOLING_LINEAR
+}Cooling;
+
+typedef struct
+{
+    FILE *scoreFile;
+    FILE *bestResultFile;
+    FILE *bestImageFile; // image of the best layout, needs problem->writeImage
+    FILE *profileFile; // periodic profile samples, needs PROFILE
+    uint64_t profileInterval;
+    uint64_t maxIteration; // shared by all chains
+    bool useScoreCutoff; // stop evaluating neighbours that won't be accepted
+    bool stopAtLowerBound; // stop once the best reaches problem->lowerBound
+    Acceptance acceptance;
+    Cooling cooling;
+    // Temperatures are relative to the current score, a neighbour that is 
+    // worse by temperature * score is accepted with probability 1/e.
+    float startTemperature;
+    float endTemperature;
+    int lateAcceptanceLength;
+    int chainCount; // independent chains, one per core when 0
+    bool useSeeds; // chain i starts from problem->seedChromosom seed i if there is one
+}AnnealingSettings;
+
+// Single trajectory search driven by problem->localMove. Simulated annealing
+// or late acceptance hill climbing, optionally as parallel multi-start. 
+// Multiple chains need problem->clone.
+RunResult annealing_run(Problem *problem, AnnealingSettings *settings);
+
+#endif
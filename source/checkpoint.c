@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "checkpoint.h"
+
+struct Checkpoint
+{
+    char *path;
+    char *temporaryPath;
+    void *buffer;
+    size_t capacity;
+    size_t size;
+    pthread_t thread;
+    bool running;
+    bool done;
+};
+
+Checkpoint *checkpoint_create(char *path)
+{
+    Checkpoint *checkpoint = calloc(1, sizeof (Checkpoint));
+    checkpoint->path = strdup(path);
+    checkpoint->temporaryPath = malloc(strlen(path) + 5);
+    sprintf(checkpoint->temporaryPath, "%s.tmp", path);
+    return checkpoint;
+}
+
+static void *writer(void *data)
+{
+    Checkpoint *checkpoint = (Checkpoint *)data;
+    FILE *file = fopen(checkpoint->temporaryPath, "wb");
+    assert(file);
+    size_t written = fwrite(checkpoint->buffer, 1, checkpoint->size, file);
+    assert(written == checkpoint->size);
+    fflush(file);
+    fclose(file);
+    rename(checkpoint->temporaryPath, checkpoint->path);
+    __atomic_store_n(&checkpoint->done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void *checkpoint_begin(Checkpoint *checkpoint, size_t size, bool wait)
+{
+    if(checkpoint->running)
+    {
+        if(!wait && !__atomic_load_n(&checkpoint->done, __ATOMIC_ACQUIRE))
+            return NULL;
+        pthread_join(checkpoint->thread, NULL);
+        checkpoint->running = false;
+    }
+    if(size > checkpoint->capacity)
+    {
+        checkpoint->buffer = realloc(checkpoint->buffer, size);
+        checkpoint->capacity = size;
+    }
+    checkpoint->size = size;
+    return checkpoint->buffer;
+}
+
+void checkpoint_commit(Checkpoint *checkpoint)
+{
+    assert(!checkpoint->running);
+    checkpoint->done = false;
+    checkpoint->running = true;
+    pthread_create(&checkpoint->thread, NULL, writer, checkpoint);
+}
+
+void checkpoint_free(Checkpoint *checkpoint)
+{
+    if(checkpoint->running)
+        pthread_join(checkpoint->thread, NULL);
+    free(checkpoint->buffer);
+    free(checkpoint->path);
+    free(checkpoint->temporaryPath);
+    free(checkpoint);
+}
+
+void *checkpoint_read(char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if(!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    void *buffer = malloc(*size);
+    size_t read = fread(buffer, 1, *size, file);
+    assert(read == *size);
+    fclose(file);
+    return buffer;
+}
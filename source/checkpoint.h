@@ -0,0 +1,21 @@
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Writes snapshots of a search to path on a background thread. The file is
+// replaced atomically, so a preempted job always leaves a complete one.
+typedef struct Checkpoint Checkpoint;
+
+Checkpoint *checkpoint_create(char *path);
+// Buffer of size bytes to serialize into. Without wait it is NULL while the
+// previous write is still running. checkpoint_commit starts writing it.
+void *checkpoint_begin(Checkpoint *checkpoint, size_t size, bool wait);
+void checkpoint_commit(Checkpoint *checkpoint);
+// Waits for the last write
+void checkpoint_free(Checkpoint *checkpoint);
+// Whole file in a malloced buffer, NULL if it doesn't exist
+void *checkpoint_read(char *path, size_t *size);
+
+#endif
@@ -4,15 +4,28 @@
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <math.h>
 #include "problem.h"
+#include "profile.h"
 #include "genetic.h"
+#include "checkpoint.h"
 #include "pcg_basic.h"
 
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#define MAX(A, B) ((A) > (B) ? (A) : (B))
+
+#define MUTATION_MIN 0.001f
+#define MUTATION_MAX 1.0f
+#define DIVERSITY_PAIRS 64
+
 typedef struct
 {
     void *chromosom;
     int score;
     double weight;
+    float mutationRate;
+    float mutationDistance;
+    int parentScore; // better score of the parents, for the success ratio
 }Individual;
 
 typedef struct
@@ -22,14 +35,48 @@ typedef struct
     Individual *current;
     Individual *next;
     Individual best;
+    Individual candidate;
+    void **batch;
+    Score *scores;
+    int lowerBound;
     uint64_t iteration;
+    Checkpoint *checkpoint;
+    uint64_t nextCheckpoint;
+    float mutationRate; // of the success rule, the settings otherwise
+    float mutationDistance;
+    float adaptationRate;
+    double successRatio; // of the last generation
+    double diversity; // of the current population
 }Context;
 
+#define CHECKPOINT_MAGIC 0x32504347 // "GCP2"
+
+// Followed by the best chromosom and the score, mutation rate and distance 
+// and chromosom of every individual of the current population, in order.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t chromosomSize;
+    int32_t populationSize;
+    int32_t bestScore;
+    uint64_t iteration;
+    pcg32_random_t random;
+    float mutationRate;
+    float mutationDistance;
+}CheckpointHeader;
+
 static int individual_compareDesc(const void *a, const void *b)
 {
     return ((Individual *)a)->weight < ((Individual *)b)->weight;
 }
 
+static int individual_compareScore(const void *a, const void *b)
+{
+    int first = ((Individual *)a)->score;
+    int second = ((Individual *)b)->score;
+    return (first > second) - (first < second);
+}
+
 static Individual individual_getRandomWeighted(Individual *Individuals, int Count)
 {
     float target = pcg32_random() / (double)UINT32_MAX;
@@ -44,14 +91,19 @@ static Individual individual_getRandomWeighted(Individual *Individuals, int Coun
     return Individuals[Count - 1];
 }
 
-static void calculateAndPrintScore(Context *context, Individual *individual)
+static void printScore(Context *context, Individual *individual, Score score)
 {
-    Score score = context->problem->calculateScore(context->problem, individual->chromosom);
     individual->score = score.score;
+    PROFILE_BEGIN(PHASE_TRACE_IO);
     if(context->settings->scoreFile)
-        fprintf(context->settings->scoreFile, "%li, %i, %i, %i\n", 
-                context->iteration, score.score, score.rawScore, score.overlap);
-    if(score.overlap == 0 && context->best.score > score.score)
+        fprintf(context->settings->scoreFile, "%li, %i, %i, %i, %i\n", 
+                context->iteration, score.score, score.rawScore, score.overlap,
+                score.rejected);
+    if(context->settings->profileFile && 
+       context->iteration % context->settings->profileInterval == 0)
+        profile_printSample(context->settings->profileFile, context->iteration);
+    PROFILE_END(PHASE_TRACE_IO);
+    if(score.overlap == 0 && !score.rejected && context->best.score > score.score)
     {
         memcpy(context->best.chromosom, 
                individual->chromosom, 
@@ -61,10 +113,89 @@ static void calculateAndPrintScore(Context *context, Individual *individual)
     context->iteration++;
 }
 
+static Score calculateAndPrintScore(Context *context, Individual *individual, int cutoff)
+{
+    Score score = context->problem->calculateScore(context->problem, 
+                                                   individual->chromosom, cutoff);
+    printScore(context, individual, score);
+    return score;
+}
+
+// Scores count individuals into context->scores, in one batch if the problem
+// supports it. 
+static void calculateAndPrintScores(Context *context, Individual *individuals, 
+                                    int count, int cutoff)
+{
+    Problem *problem = context->problem;
+    if(!problem->calculateScoreBatch)
+    {
+        for(int i = 0; i < count; i++)
+            context->scores[i] = calculateAndPrintScore(context, individuals + i, cutoff);
+        return;
+    }
+    for(int i = 0; i < count; i++)
+        context->batch[i] = individuals[i].chromosom;
+    problem->calculateScoreBatch(problem, context->batch, count, cutoff, context->scores);
+    for(int i = 0; i < count; i++)
+        printScore(context, individuals + i, context->scores[i]);
+}
+
 static void printCSVHeader(Context *context)
 {
     if(context->settings->scoreFile)
-        fprintf(context->settings->scoreFile, "iteration,score,rawScore,overlap\n");
+        fprintf(context->settings->scoreFile, "iteration,score,rawScore,overlap,rejected\n");
+    if(context->settings->statsFile)
+        fprintf(context->settings->statsFile, 
+                "iteration,mutationRate,mutationDistance,successRatio,diversity,best\n");
+    if(context->settings->profileFile)
+        profile_printSampleHeader(context->settings->profileFile);
+}
+
+static void printStats(Context *context)
+{
+    GeneticSettings *settings = context->settings;
+    if(!settings->statsFile)
+        return;
+    double rate = 0;
+    double distance = 0;
+    for(int i = 0; i < settings->populationSize; i++)
+    {
+        rate += context->current[i].mutationRate;
+        distance += context->current[i].mutationDistance;
+    }
+    PROFILE_BEGIN(PHASE_TRACE_IO);
+    fprintf(settings->statsFile, "%li, %f, %f, %f, %f, %i\n", context->iteration, 
+            rate / settings->populationSize, distance / settings->populationSize, 
+            context->successRatio, context->diversity, context->best.score);
+    PROFILE_END(PHASE_TRACE_IO);
+}
+
+// Mean distance over at most DIVERSITY_PAIRS pairs, so the cost per 
+// generation doesn't grow with the population. The pairs are spread over the
+// population without drawing random numbers, which would change the search.
+static double measureDiversity(Context *context)
+{
+    Problem *problem = context->problem;
+    int populationSize = context->settings->populationSize;
+    Individual *current = context->current;
+    if(!problem->distance || populationSize < 2)
+        return 0;
+    int pairCount = populationSize * (populationSize - 1) / 2;
+    double sum = 0;
+    if(pairCount <= DIVERSITY_PAIRS)
+    {
+        for(int i = 0; i < populationSize; i++)
+            for(int j = i + 1; j < populationSize; j++)
+                sum += problem->distance(problem, current[i].chromosom, current[j].chromosom);
+        return sum / pairCount;
+    }
+    for(int k = 0; k < DIVERSITY_PAIRS; k++)
+    {
+        int i = k * populationSize / DIVERSITY_PAIRS;
+        int j = (i + 1 + k * 7919 % (populationSize - 1)) % populationSize;
+        sum += problem->distance(problem, current[i].chromosom, current[j].chromosom);
+    }
+    return sum / DIVERSITY_PAIRS;
 }
 
 static bool currentHaveSameScore(Context *context)
@@ -80,6 +211,177 @@ static bool currentHaveSameScore(Context *context)
     return true;
 }
 
+// Children above the cutoff can't become the best, but their score is only a
+// lower bound. Roulette weights, the elites, the success rule, equal score
+// detection, partial restarts and local search all read the scores of the 
+// other individuals too, so the cutoff is only used when none of them are and
+// it can't change which individuals are selected.
+static int scoreCutoff(Context *context)
+{
+    GeneticSettings *settings = context->settings;
+    if(!settings->useScoreCutoff || !settings->randomSelection || 
+       settings->restartWhenSameScore || settings->restartFraction > 0 ||
+       settings->adaptation == ADAPT_SUCCESS_RULE || 
+       settings->localSearch != LOCAL_SEARCH_NONE)
+        return INT_MAX;
+    return context->best.score;
+}
+
+// Budgeted hill climb with the problems local moves. The individuals score 
+// is the cutoff, so worse neighbours are usually rejected after a partial 
+// evaluation. Sideways moves are accepted to cross plateaus.
+static void localSearch(Context *context, Individual *individual)
+{
+    Problem *problem = context->problem;
+    Individual *candidate = &context->candidate;
+    for(int i = 0; i < context->settings->localSearchBudget; i++)
+    {
+        if(context->iteration >= context->settings->maxIteration)
+            break;
+        memcpy(candidate->chromosom, individual->chromosom, problem->chromosomSize);
+        problem->localMove(problem, candidate->chromosom);
+        Score score = calculateAndPrintScore(context, candidate, individual->score);
+        if(!score.rejected && score.score <= individual->score)
+        {
+            void *tmp = individual->chromosom;
+            individual->chromosom = candidate->chromosom;
+            individual->score = candidate->score;
+            candidate->chromosom = tmp;
+        }
+    }
+}
+
+// Returns false if the previous checkpoint is still being written and wait 
+// isn't set.
+static bool saveCheckpoint(Context *context, bool wait)
+{
+    Problem *problem = context->problem;
+    int populationSize = context->settings->populationSize;
+    size_t size = sizeof (CheckpointHeader) + problem->chromosomSize + 
+                  populationSize * (sizeof (int) + 2 * sizeof (float) + problem->chromosomSize);
+    char *buffer = checkpoint_begin(context->checkpoint, size, wait);
+    if(!buffer)
+        return false;
+    CheckpointHeader header =
+    {
+        .magic = CHECKPOINT_MAGIC,
+        .chromosomSize = problem->chromosomSize,
+        .populationSize = populationSize,
+        .bestScore = context->best.score,
+        .iteration = context->iteration,
+        .random = pcg32_getstate(),
+        .mutationRate = context->mutationRate,
+        .mutationDistance = context->mutationDistance,
+    };
+    memcpy(buffer, &header, sizeof (header));
+    buffer += sizeof (header);
+    memcpy(buffer, context->best.chromosom, problem->chromosomSize);
+    buffer += problem->chromosomSize;
+    for(int i = 0; i < populationSize; i++)
+    {
+        memcpy(buffer, &context->current[i].score, sizeof (int));
+        buffer += sizeof (int);
+        memcpy(buffer, &context->current[i].mutationRate, sizeof (float));
+        buffer += sizeof (float);
+        memcpy(buffer, &context->current[i].mutationDistance, sizeof (float));
+        buffer += sizeof (float);
+        memcpy(buffer, context->current[i].chromosom, problem->chromosomSize);
+        buffer += problem->chromosomSize;
+    }
+    checkpoint_commit(context->checkpoint);
+    return true;
+}
+
+static bool loadCheckpoint(Context *context)
+{
+    Problem *problem = context->problem;
+    int populationSize = context->settings->populationSize;
+    size_t size;
+    char *data = checkpoint_read(context->settings->checkpointPath, &size);
+    if(!data)
+        return false;
+    CheckpointHeader header;
+    memcpy(&header, data, sizeof (header));
+    assert(header.magic == CHECKPOINT_MAGIC);
+    assert(header.chromosomSize == problem->chromosomSize);
+    assert(header.populationSize == populationSize);
+    assert(size == sizeof (header) + problem->chromosomSize + 
+                   populationSize * (sizeof (int) + 2 * sizeof (float) + problem->chromosomSize));
+    char *buffer = data + sizeof (header);
+    context->best.score = header.bestScore;
+    context->iteration = header.iteration;
+    pcg32_setstate(header.random);
+    context->mutationRate = header.mutationRate;
+    context->mutationDistance = header.mutationDistance;
+    memcpy(context->best.chromosom, buffer, problem->chromosomSize);
+    buffer += problem->chromosomSize;
+    for(int i = 0; i < populationSize; i++)
+    {
+        memcpy(&context->current[i].score, buffer, sizeof (int));
+        buffer += sizeof (int);
+        memcpy(&context->current[i].mutationRate, buffer, sizeof (float));
+        buffer += sizeof (float);
+        memcpy(&context->current[i].mutationDistance, buffer, sizeof (float));
+        buffer += sizeof (float);
+        memcpy(context->current[i].chromosom, buffer, problem->chromosomSize);
+        buffer += problem->chromosomSize;
+    }
+    free(data);
+    return true;
+}
+
+// Standard normal sample, Box-Muller
+static float gaussian(void)
+{
+    float radius = sqrtf(-2 * logf(1 - pcg32_fraction()));
+    return radius * cosf(2 * (float)M_PI * pcg32_fraction());
+}
+
+static float clampMutation(float value)
+{
+    return MAX(MIN(value, MUTATION_MAX), MUTATION_MIN);
+}
+
+static void resetMutation(Context *context, Individual *individual)
+{
+    individual->mutationRate = context->mutationRate;
+    individual->mutationDistance = context->mutationDistance;
+}
+
+static void mutateChild(Context *context, Individual *mother, Individual *father, 
+                        Individual *child)
+{
+    Problem *problem = context->problem;
+    child->parentScore = MIN(mother->score, father->score);
+    if(context->settings->adaptation == ADAPT_SELF)
+    {
+        float step = context->adaptationRate;
+        float rate = sqrtf(mother->mutationRate * father->mutationRate);
+        float distance = sqrtf(mother->mutationDistance * father->mutationDistance);
+        child->mutationRate = clampMutation(rate * expf(step * gaussian()));
+        child->mutationDistance = clampMutation(distance * expf(step * gaussian()));
+    }
+    else
+        resetMutation(context, child);
+    problem->mutate(problem, child->mutationRate, child->mutationDistance, child->chromosom);
+}
+
+static void adaptMutation(Context *context, int successCount, int childCount)
+{
+    if(childCount == 0)
+        return;
+    context->successRatio = (double)successCount / childCount;
+    if(context->settings->adaptation != ADAPT_SUCCESS_RULE)
+        return;
+    float factor = 1;
+    if(context->successRatio > 0.2)
+        factor = expf(context->adaptationRate);
+    else if(context->successRatio < 0.2)
+        factor = expf(-context->adaptationRate);
+    context->mutationRate = clampMutation(context->mutationRate * factor);
+    context->mutationDistance = clampMutation(context->mutationDistance * factor);
+}
+
 static bool genetic_step(Context *context)
 {
     Problem *problem = context->problem;
@@ -87,6 +389,7 @@ static bool genetic_step(Context *context)
     Individual *current = context->current;
     Individual *next = context->next;
 
+    PROFILE_BEGIN(PHASE_SELECTION);
     double totalInvScore = 0;
     for(int i = 0; i < settings->populationSize; i++)
         totalInvScore += 1.0 / current[i].score;
@@ -102,40 +405,125 @@ static bool genetic_step(Context *context)
     {
         memcpy(next[i].chromosom, current[i].chromosom, problem->chromosomSize);
         next[i].score = current[i].score;
+        next[i].mutationRate = current[i].mutationRate;
+        next[i].mutationDistance = current[i].mutationDistance;
     }
+    PROFILE_END(PHASE_SELECTION);
+    if(settings->localSearch == LOCAL_SEARCH_ELITES)
+        for(int i = 0; i < settings->eliteCount; i++)
+            localSearch(context, next + i);
+    int cutoff = scoreCutoff(context);
+    bool restart = false;
+    int childEnd = settings->eliteCount;
     for(int i = settings->eliteCount; i < settings->populationSize; i+=2)
     {
+        PROFILE_BEGIN(PHASE_SELECTION);
         Individual mother = individual_getRandomWeighted(current, settings->populationSize);
         Individual father = individual_getRandomWeighted(current, settings->populationSize);
+        PROFILE_END(PHASE_SELECTION);
         //TODO: check that mother != father
         problem->crossover(problem, mother.chromosom, father.chromosom,
                            next[i].chromosom, next[i+1].chromosom);
-        problem->mutate(problem, settings->mutationRate, 
-                        settings->mutationDistance, next[i].chromosom);
-        calculateAndPrintScore(context, next + i);
+        mutateChild(context, &mother, &father, next + i);
         if(i + 1 < settings->populationSize)
+            mutateChild(context, &mother, &father, next + i + 1);
+        childEnd = MIN(i + 2, settings->populationSize);
+        if(!restart && pcg32_fraction() <= settings->restartProbability)
+        {
+            restart = true;
+            //A partial restart keeps the children, so all of them are needed
+            if(settings->restartFraction == 0)
+                break;
+        }
+    }
+    //After a full restart the missing children are reinitialized anyway
+    int childCount = childEnd - settings->eliteCount;
+    calculateAndPrintScores(context, next + settings->eliteCount, childCount, cutoff);
+    int successCount = 0;
+    for(int i = 0; i < childCount; i++)
+    {
+        Individual *child = next + settings->eliteCount + i;
+        if(!context->scores[i].rejected && child->score < child->parentScore)
+            successCount++;
+    }
+    adaptMutation(context, successCount, childCount);
+    if(settings->localSearch == LOCAL_SEARCH_OFFSPRING)
+        for(int i = 0; i < childCount; i++)
+            if(!context->scores[i].rejected)
+                localSearch(context, next + settings->eliteCount + i);
+    return restart;
+}
+
+// Reinitializes the whole population, or with restartFraction that share of
+// its worst non-elite individuals.
+static void restartPopulation(Context *context, Individual *population)
+{
+    Problem *problem = context->problem;
+    GeneticSettings *settings = context->settings;
+    PROFILE_COUNT(COUNTER_RESTARTS, 1);
+    int first = 0;
+    if(settings->restartFraction > 0)
+    {
+        int keep = MIN(settings->eliteCount, settings->populationSize);
+        int count = ceilf(settings->restartFraction * (settings->populationSize - keep));
+        first = settings->populationSize - MIN(count, settings->populationSize - keep);
+        qsort(population, settings->populationSize, sizeof (Individual), 
+              individual_compareScore);
+    }
+    for(int i = first; i < settings->populationSize; i++)
+    {
+        problem->initializeChromosom(problem, population[i].chromosom);
+        resetMutation(context, population + i);
+    }
+    calculateAndPrintScores(context, population + first, 
+                            settings->populationSize - first, INT_MAX);
+}
+
+static void initializePopulation(Context *context)
+{
+    Problem *problem = context->problem;
+    GeneticSettings *settings = context->settings;
+    int seeded = 0;
+    for(int i = 0; i < settings->populationSize; i++)
+    {
+        void *chromosom = context->current[i].chromosom;
+        resetMutation(context, &context->current[i]);
+        if(i >= settings->seedCount || !problem->seedChromosom)
+            problem->initializeChromosom(problem, chromosom);
+        else if(problem->seedChromosom(problem, i, chromosom))
+            seeded++;
+        else if(seeded > 0)
         {
+            memcpy(chromosom, context->current[i % seeded].chromosom, problem->chromosomSize);
             problem->mutate(problem, settings->mutationRate, 
-                    settings->mutationDistance, next[i+1].chromosom);
-            calculateAndPrintScore(context, next + i + 1);
+                            settings->mutationDistance, chromosom);
         }
-        if(pcg32_fraction() <= settings->restartProbability)
-            return true;
+        else
+            problem->initializeChromosom(problem, chromosom);
     }
-    return false;
 }
 
-void genetic_run(Problem *problem, GeneticSettings *settings)
+RunResult genetic_run(Problem *problem, GeneticSettings *settings)
 {
     Context context = 
     {
         .problem = problem,
         .settings = settings,
         .current = calloc(settings->populationSize + 1, sizeof (Individual)),
-        .next    = calloc(settings->populationSize + 1, sizeof (Individual))
+        .next    = calloc(settings->populationSize + 1, sizeof (Individual)),
+        .batch   = calloc(settings->populationSize + 1, sizeof (void *)),
+        .scores  = calloc(settings->populationSize + 1, sizeof (Score)),
+        .mutationRate = settings->mutationRate,
+        .mutationDistance = settings->mutationDistance,
+        .adaptationRate = settings->adaptationRate > 0 ? settings->adaptationRate : 0.2,
     };
+    assert(!settings->profileFile || settings->profileInterval > 0);
+    profile_reset();
+    context.lowerBound = problem->lowerBound ? problem->lowerBound(problem) : 0;
     printCSVHeader(&context);
-    size_t individualCount = settings->populationSize * 2 + 3;
+    assert(settings->localSearch == LOCAL_SEARCH_NONE || problem->localMove);
+    assert(settings->restartDiversity == 0 || problem->distance);
+    size_t individualCount = settings->populationSize * 2 + 4;
     char *chromosomes = malloc(individualCount * problem->chromosomSize);
     context.best = (Individual)
     {
@@ -143,34 +531,68 @@ void genetic_run(Problem *problem, GeneticSettings *settings)
         .score = INT_MAX,
     };
     chromosomes += problem->chromosomSize;
+    context.candidate.chromosom = chromosomes;
+    chromosomes += problem->chromosomSize;
     for(int i = 0; i < settings->populationSize + 1; i++)
     {
         context.current[i].chromosom = chromosomes;
         context.next[i].chromosom    = chromosomes + problem->chromosomSize;
         chromosomes += problem->chromosomSize * 2;
-        if(i < settings->populationSize)
-        {
-            problem->initializeChromosom(problem, context.current[i].chromosom);
-            calculateAndPrintScore(&context, &context.current[i]);
-        }
+    }
+    if(!settings->resume || !loadCheckpoint(&context))
+    {
+        initializePopulation(&context);
+        calculateAndPrintScores(&context, context.current, settings->populationSize, INT_MAX);
+    }
+    if(settings->checkpointPath)
+    {
+        assert(settings->checkpointInterval > 0);
+        context.checkpoint = checkpoint_create(settings->checkpointPath);
+        context.nextCheckpoint = (context.iteration / settings->checkpointInterval + 1) * 
+                                 settings->checkpointInterval;
     }
 
     while(context.iteration < settings->maxIteration)
     {
-        if((settings->restartWhenSameScore && currentHaveSameScore(&context))
-                    || genetic_step(&context))
-        {
-            for(int i = 0; i < settings->populationSize; i++)
-            {
-                problem->initializeChromosom(problem, context.next[i].chromosom);
-                calculateAndPrintScore(&context, &context.next[i]);
-            }
-        }
+        //A busy writer delays the checkpoint to the next generation
+        if(context.checkpoint && context.iteration >= context.nextCheckpoint &&
+           saveCheckpoint(&context, false))
+            context.nextCheckpoint = (context.iteration / settings->checkpointInterval + 1) *
+                                     settings->checkpointInterval;
+        if(settings->stopAtLowerBound && context.best.score <= context.lowerBound)
+            break;
+        bool restart = settings->restartWhenSameScore && currentHaveSameScore(&context);
+        //A partial restart keeps the best of the next generation, a full
+        //restart replaces all of it
+        if(!restart || settings->restartFraction > 0)
+            restart |= genetic_step(&context);
+        if(restart)
+            restartPopulation(&context, context.next);
         Individual *Tmp = context.current;
         context.current = context.next;
         context.next = Tmp;
+        if(settings->statsFile || settings->restartDiversity > 0)
+            context.diversity = measureDiversity(&context);
+        if(context.diversity < settings->restartDiversity)
+            restartPopulation(&context, context.current);
+        printStats(&context);
+    }
+    if(context.checkpoint)
+    {
+        saveCheckpoint(&context, true);
+        checkpoint_free(context.checkpoint);
     }
     if(problem->printChromosom && settings->bestResultFile)
         problem->printChromosom(problem, context.best.chromosom, 
                                 settings->bestResultFile);
+    if(problem->writeImage && settings->bestImageFile)
+        problem->writeImage(problem, context.best.chromosom, settings->bestImageFile);
+    profile_printSummary(stdout, problem->name);
+    problem_printGap(problem, context.best.score, context.lowerBound);
+    return (RunResult)
+    {
+        .bestScore = context.best.score,
+        .lowerBound = context.lowerBound,
+        .iterations = context.iteration,
+    };
 }
@@ -3,20 +3,72 @@
 
 #include "problem.h"
 
+typedef enum
+{
+    LOCAL_SEARCH_NONE,
+    LOCAL_SEARCH_OFFSPRING,
+    LOCAL_SEARCH_ELITES
+}LocalSearch;
+
+typedef enum
+{
+    ADAPT_NONE,
+    // 1/5th success rule: mutationRate and mutationDistance grow by 
+    // exp(adaptationRate) after a generation in which more than a fifth of 
+    // the children beat their better parent, and shrink after one with less.
+    ADAPT_SUCCESS_RULE,
+    // Every individual carries its own rate and distance. Children inherit the
+    // geometric mean of their parents values, scaled by 
+    // exp(adaptationRate * N(0, 1)), and mutate with them.
+    ADAPT_SELF
+}MutationAdaptation;
+
 typedef struct
 {
     FILE *scoreFile;
     FILE *bestResultFile;
+    FILE *bestImageFile; // image of the best layout, needs problem->writeImage
+    FILE *profileFile; // periodic profile samples, needs PROFILE
+    uint64_t profileInterval;
     uint64_t maxIteration;
     int populationSize;
     int eliteCount;
     bool randomSelection;
-    float mutationRate;
+    float mutationRate; // initial values with adaptation
     float mutationDistance;
+    MutationAdaptation adaptation;
+    float adaptationRate; // 0 uses 0.2
+    // Per generation: mean mutation rate and distance, success ratio, 
+    // diversity (needs problem->distance) and best
+    FILE *statsFile;
     float restartProbability;
     bool restartWhenSameScore;
+    // Restart once the diversity, the mean problem->distance of a fixed sample
+    // of pairs of the population, drops below restartDiversity. 0 disables.
+    float restartDiversity;
+    // Share of the non-elite individuals that a restart reinitializes, the 
+    // worst ones. 0 reinitializes the whole population.
+    float restartFraction;
+    // Stop evaluating children that can't matter. Only takes effect with 
+    // randomSelection and without restarts, the success rule or local search,
+    // tournament runs are evaluated in full. See scoreCutoff.
+    bool useScoreCutoff;
+    bool stopAtLowerBound; // stop once the best reaches problem->lowerBound
+    LocalSearch localSearch; // needs problem->localMove
+    int localSearchBudget; // evaluations per improved individual
+    // Initial individuals taken from problem->seedChromosom. Once the seeds
+    // run out the rest of them are mutated copies of the seeds.
+    int seedCount;
+    // Population, best, iteration and random state are written to 
+    // checkpointPath every checkpointInterval iterations and at the end.
+    // With resume a run continues from the checkpoint if there is one, 
+    // exactly as the run that wrote it would have. The score file then 
+    // only gets the iterations after the checkpoint.
+    char *checkpointPath;
+    uint64_t checkpointInterval;
+    bool resume;
 }GeneticSettings;
 
-void genetic_run(Problem *problem, GeneticSettings *settings);
+RunResult genetic_run(Problem *problem, GeneticSettings *settings);
 
 #endif
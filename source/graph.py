@@ -1,5 +1,7 @@
-from os import listdir
-from os.path import join, isfile, splitext, basename
+from os import listdir, cpu_count, walk, rename, remove
+from os.path import join, isfile, splitext, basename, dirname
+import matplotlib
+matplotlib.use('Agg')
 from matplotlib import pyplot as plt
 from matplotlib.colors import ListedColormap
 from matplotlib.lines import Line2D
@@ -9,60 +11,97 @@ import pandas as pd
 import numpy as np
 from scipy.signal import argrelextrema
 import argparse
-from io import StringIO
+from functools import partial
+from multiprocessing import Pool
 from pathlib import Path
+from time import sleep
 
 
+# Score traces: a one row header (optimum, lower bound) above the samples.
+# The samples are parsed straight from the memory mapped file.
+def readTrace(path):
+    header = pd.read_csv(path, nrows=1, skipinitialspace=True)
+    data = pd.read_csv(path, skiprows=2, skipinitialspace=True, memory_map=True, engine='c')
+    return header, data
+
+def traceStats(score, overlap, rejected):
+    valid = score[(overlap == 0) & (rejected == 0)]
+    if len(valid) == 0:
+        return {'valid': 0, 'total': len(score), 'min': np.nan, 'max': np.nan,
+                'avg': np.nan, 'median': np.nan}
+    return {'valid': len(valid), 'total': len(score), 'min': valid.min(), 'max': valid.max(),
+            'avg': np.average(valid), 'median': np.median(valid)}
+
 def plotGraph(path, showInfo):
-    with open(path) as file:
-        lines = file.readlines()
-    header = pd.read_csv(StringIO('\n'.join(lines[:2])))
-    data = pd.read_csv(StringIO('\n'.join(lines[2:])))
+    header, data = readTrace(path)
     iteration = data['iteration'].to_numpy()
     score = data['score'].to_numpy()
     overlap = data['overlap'].to_numpy()
-    colorIndex = overlap
-    colorIndex[colorIndex > 0] = 1
+    rejected = data['rejected'].to_numpy() if 'rejected' in data else np.zeros_like(overlap)
+    colorIndex = (overlap > 0).astype(np.int8)
 
     colormap = ListedColormap(["#071a56", "#e2060a"])
     fig, axis = plt.subplots(1, 1)
     axis.scatter(iteration, score, c = colorIndex, marker='x', cmap=colormap, linewidths=1)
     axis.axhline(header['optimum'][0], color='black', dashes=[4, 2], linewidth=1, label='optimum')
+    if 'lowerBound' in header:
+        axis.axhline(header['lowerBound'][0], color='grey', dashes=[1, 2], linewidth=1, label='lower bound')
     axis.set_xlabel('Sample index')
     axis.set_ylabel('Score')
     axis.set_ylim(0)
 
-    valid = score[overlap == 0]
-    validCount = len(valid)
-    totalCount = len(colorIndex)
-    best = min(valid)
-    worst = max(valid)
-    average = np.average(valid)
-    median = np.median(valid)
-
-    stats = 'valid: {}/{} min: {} max: {} avg: {} median: {}'.format(validCount, totalCount, best, worst, average, median)
+    stats = traceStats(score, overlap, rejected)
     with open(path + '.txt', 'w') as f:
-        f.write(stats)
+        f.write('valid: {}/{} min: {} max: {} avg: {} median: {}'.format(
+            stats['valid'], stats['total'], stats['min'], stats['max'], stats['avg'], stats['median']))
     plt.legend()
-    
-def plotImage(path, showInfo):
-    data = pd.read_csv(path).to_numpy()
-    xMax = max(data[:, 0])
-    xMin = min(data[:, 0])
-    yMax = max(data[:, 1])
-    yMin = min(data[:, 1])
+    if 'optimum' in header:
+        stats['optimum'] = header['optimum'][0]
+    if 'lowerBound' in header:
+        stats['lowerBound'] = header['lowerBound'][0]
+    return stats
+
+def loadShapes(path):
+    data = pd.read_csv(path, skipinitialspace=True, engine='c', dtype=np.int64).to_numpy()
+    grid = np.full((data[:, 1].max() + 1, data[:, 0].max() + 1), -1)
+    grid[data[:, 1], data[:, 0]] = data[:, 2]
+    shapes = {}
+    for index in np.unique(data[:, 2]):
+        ys, xs = np.nonzero(grid == index)
+        shapes[index] = grid[ys.min():ys.max() + 1, xs.min():xs.max() + 1] == index
+    return shapes
+
+# Placement lists only hold positions, the shapes come from the problem file
+def placementCells(path, problems):
+    with open(path) as file:
+        file.readline()
+        name = file.readline().split(',')[0].strip()
+    shapes = loadShapes(join(problems, name + '.csv'))
+    data = pd.read_csv(path, skiprows=2, skipinitialspace=True).to_numpy()
+    pageStride = int(data[:, 1].max() + data[:, 3].max() + 1)
+    cells = []
+    for index, x, y, page in data[:, [0, 1, 2, 6]].astype(int):
+        ys, xs = np.nonzero(shapes[index])
+        cells.append(np.column_stack((xs + x + page * pageStride, ys + y, np.full(len(xs), index))))
+    return np.concatenate(cells)
+
+def plotImage(path, showInfo, problems):
+    with open(path) as file:
+        isPlacement = file.readline().startswith('problem')
+    if isPlacement:
+        data = placementCells(path, problems)
+    else:
+        data = pd.read_csv(path, skipinitialspace=True, engine='c', dtype=np.int64).to_numpy()
+    xMin, yMin = data[:, :2].min(axis=0)
+    xMax, yMax = data[:, :2].max(axis=0)
     dimX = (xMax - xMin + 1)
     dimY = (yMax - yMin + 1)
-    score =  dimX * dimY 
     image = np.zeros((dimY, dimX))
     alpha = np.zeros((dimY, dimX))
-    for rowIndex in range(data.shape[0]):
-        row = data[rowIndex, :]
-        image[row[1]-yMin, row[0]-xMin] = row[2]
-        alpha[row[1]-yMin, row[0]-xMin] = 1
+    image[data[:, 1] - yMin, data[:, 0] - xMin] = data[:, 2]
+    alpha[data[:, 1] - yMin, data[:, 0] - xMin] = 1
 
     fig, axis = plt.subplots(1, 1)
-    intervals = np.linspace(0.5, 8.5, 9)
     axis.set_xticks(np.linspace(0.5, dimX - 1.5, dimX - 1), minor=True)
     axis.set_yticks(np.linspace(0.5, dimY - 1.5, dimY - 1), minor=True)
     axis.tick_params(which='minor', bottom=showInfo, top=False, left=showInfo)
@@ -70,23 +109,122 @@ def plotImage(path, showInfo):
     axis.set_xlabel('Grid x')
     axis.set_ylabel('Grid y')
     imshow = axis.imshow(image, cmap='plasma', alpha=alpha, extent=[xMin-.5, xMax+.5, yMax+.5, yMin-.5])
-    
-def createPdf(directory, plot):
-    files = [file for file in [join(directory, name) for name in listdir(directory)] if splitext(file)[1] == ".csv"]
+
+# Manifests and summaries sit next to the data files
+def csvFiles(directory):
+    files = [join(directory, name) for name in listdir(directory)
+             if splitext(name)[1] == ".csv" and name not in ('manifest.csv', 'summary.csv')]
     files.sort()
+    return files
+
+def createPdf(directory, plot):
     with PdfPages(join(directory, 'plots.pdf')) as pdf:
-        for file in files:
+        for file in csvFiles(directory):
             plot(file)
             pdf.savefig()
             plt.close()
 
-def createImages(directory, plot):
-    files = [file for file in [join(directory, name) for name in listdir(directory)] if splitext(file)[1] == ".csv"]
-    files.sort()
-    for file in files:
-        plot(file)
-        savepath = "{}/{}.png".format(directory, Path(file).stem)
-        plt.savefig(savepath, dpi=150, bbox_inches='tight', transparent=True)
+# Runs in the worker processes, pyplot state is per process
+def renderImage(plot, file):
+    result = plot(file)
+    savepath = "{}/{}.png".format(dirname(file), Path(file).stem)
+    plt.savefig(savepath, dpi=150, bbox_inches='tight', transparent=True)
+    plt.close('all')
+    return file, result
+
+def renderAll(jobs, jobCount):
+    if jobCount <= 1 or len(jobs) <= 1:
+        return [renderImage(plot, file) for plot, file in jobs]
+    with Pool(min(jobCount, len(jobs))) as pool:
+        return pool.starmap(renderImage, jobs, chunksize=1)
+
+# Files are named <problem>_<seed>.csv, the runs of one problem are aggregated
+# into summary.csv next to the scores directory
+def writeSummary(directory, results):
+    rows = []
+    for file, stats in results:
+        if stats is None:
+            continue
+        problem, _, seed = Path(file).stem.rpartition('_')
+        rows.append(dict(stats, problem=problem or seed, seed=seed))
+    if not rows:
+        return
+    runs = pd.DataFrame(rows)
+    runs['validRatio'] = runs['valid'] / runs['total']
+    summary = runs.groupby('problem').agg(
+        runs=('seed', 'count'),
+        best=('min', 'min'),
+        mean=('min', 'mean'),
+        std=('min', 'std'),
+        median=('min', 'median'),
+        worst=('min', 'max'),
+        validRatio=('validRatio', 'mean'))
+    for column in ('optimum', 'lowerBound'):
+        if column in runs:
+            summary[column] = runs.groupby('problem')[column].first()
+    if 'lowerBound' in summary:
+        summary['gap'] = summary['mean'] / summary['lowerBound'] - 1
+    summary.to_csv(join(dirname(directory.rstrip('/')), 'summary.csv'))
+    print('{}:\n{}'.format(directory, summary.to_string()))
+
+def renderJobs(jobs, jobCount):
+    results = renderAll(jobs, jobCount)
+    byDirectory = {}
+    for file, stats in results:
+        byDirectory.setdefault(dirname(file), []).append((file, stats))
+    for directory, directoryResults in sorted(byDirectory.items()):
+        if basename(directory) == 'scores':
+            writeSummary(directory, directoryResults)
+
+# Every scores and best directory below path, rendered in one pool
+def processSweep(path, showInfo, problems, jobCount):
+    graph = partial(plotGraph, showInfo=showInfo)
+    image = partial(plotImage, showInfo=showInfo, problems=problems)
+    jobs = []
+    for directory, _, _ in sorted(walk(path)):
+        if basename(directory) == 'scores':
+            jobs += [(graph, file) for file in csvFiles(directory)]
+        elif basename(directory) == 'best':
+            jobs += [(image, file) for file in csvFiles(directory)]
+    renderJobs(jobs, jobCount)
+
+# Manifests list the files the solver wrote as kind,path rows. Kinds without
+# a plot (atlas images, fronts) are skipped.
+def processManifest(path, showInfo, problems, jobCount):
+    plots = {
+        'scores': partial(plotGraph, showInfo=showInfo),
+        'best': partial(plotImage, showInfo=showInfo, problems=problems),
+        'problem': partial(plotImage, showInfo=True, problems=problems),
+    }
+    manifest = pd.read_csv(path, skipinitialspace=True)
+    renderJobs([(plots[kind], file) for kind, file in zip(manifest['kind'], manifest['path'])
+                if kind in plots], jobCount)
+
+# Background post-processing: every <name>.job file in the queue directory
+# holds the path of a manifest. Jobs are claimed by renaming them, so several
+# workers can share a queue. Exits once the queue is empty after the solver
+# created the stop file.
+def runWorker(queue, showInfo, problems, jobCount):
+    while True:
+        stopping = isfile(join(queue, 'stop'))
+        jobs = sorted(name for name in listdir(queue) if splitext(name)[1] == '.job')
+        if not jobs:
+            if stopping:
+                return
+            sleep(0.5)
+            continue
+        claimed = join(queue, splitext(jobs[0])[0] + '.running')
+        try:
+            rename(join(queue, jobs[0]), claimed)
+        except FileNotFoundError:
+            continue
+        with open(claimed) as file:
+            manifest = file.readline().strip()
+        try:
+            processManifest(manifest, showInfo, problems, jobCount)
+        except Exception as error:
+            print('{}: {}'.format(manifest, error))
+        remove(claimed)
 
 # Main function. You don't have to change this
 if __name__ == '__main__':
@@ -94,10 +232,18 @@ if __name__ == '__main__':
     parser.add_argument('path')
     parser.add_argument('-t', '--type')
     parser.add_argument('-i', '--info', action='store_true')
+    parser.add_argument('-p', '--problems', default='data/problems')
+    parser.add_argument('-j', '--jobs', type=int, default=cpu_count())
     args = parser.parse_args()
-    if args.type == 'image':
-        plot = (lambda a : plotImage(a, args.info))
-        createImages(args.path, plot)
+    if args.type == 'sweep':
+        processSweep(args.path, args.info, args.problems, args.jobs)
+    elif args.type == 'manifest':
+        processManifest(args.path, args.info, args.problems, args.jobs)
+    elif args.type == 'worker':
+        runWorker(args.path, args.info, args.problems, args.jobs)
+    elif args.type == 'image':
+        plot = partial(plotImage, showInfo=args.info, problems=args.problems)
+        renderAll([(plot, file) for file in csvFiles(args.path)], args.jobs)
     else:
-        plot = (lambda a : plotGraph(a, args.info))
-        createImages(args.path, plot)
+        plot = partial(plotGraph, showInfo=args.info)
+        writeSummary(args.path, renderAll([(plot, file) for file in csvFiles(args.path)], args.jobs))
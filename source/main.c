@@ -16,85 +16,375 @@
 #include "spritePacking.c"
 #include "genetic.h"
 #include "random.h"
+#include "annealing.h"
+#include "nsga.h"
+#include "parallel.h"
+#include "sweep.h"
 
 
 #define SPRITES(name) (Sprites){name ## _Width, name ## _Height, name, #name}
 
-void printProblem(Sprites sprites)
+// Plots are rendered by a separate graph.py worker that polls this directory,
+// so the experiments don't wait for them. NULL disables plotting.
+static char *plotQueue = "data/queue";
+static int plotJobCount;
+
+// Every experiment folder gets a manifest of the files written for it
+FILE *openManifest(char *folderName)
 {
     char buffer[512];
-    system("mkdir -p data/problems");
-    snprintf(buffer, sizeof(buffer), "data/problems/%s.csv", sprites.name);
-    FILE *file = fopen(buffer, "w");
-    spritePacking_printProblem(sprites.width, sprites.height, sprites.indexes, file);
+    snprintf(buffer, sizeof(buffer), "data/%s/manifest.csv", folderName);
+    FILE *manifest = fopen(buffer, "w");
+    assert(manifest);
+    fprintf(manifest, "kind,path\n");
+    return manifest;
+}
+
+void queuePlots(char *folderName)
+{
+    if(!plotQueue)
+        return;
+    char job[512];
+    char path[512];
+    snprintf(job, sizeof(job), "%s/%04i_%s.tmp", plotQueue, plotJobCount, folderName);
+    FILE *file = fopen(job, "w");
+    assert(file);
+    fprintf(file, "data/%s/manifest.csv\n", folderName);
     fclose(file);
+    // The worker only picks up complete jobs
+    snprintf(path, sizeof(path), "%s/%04i_%s.job", plotQueue, plotJobCount, folderName);
+    rename(job, path);
+    plotJobCount++;
 }
 
-void evaluateRandom(Problem *problems, 
-                    int problemCount,
-                    char *folderName,
-                    SpritePackerSettings packerSettings, 
-                    RandomSettings randomSettings)
+void startPlotWorker()
 {
+    if(!plotQueue)
+        return;
     char buffer[512];
-    snprintf(buffer, sizeof(buffer), "mkdir -p data/%s/scores", folderName);
+    snprintf(buffer, sizeof(buffer), "mkdir -p %s && rm -f %s/stop", plotQueue, plotQueue);
     system(buffer);
-    snprintf(buffer, sizeof(buffer), "mkdir -p data/%s/best", folderName);
+    snprintf(buffer, sizeof(buffer), "python3 source/graph.py %s -t worker &", plotQueue);
     system(buffer);
-    for(int problemIndex = 0; problemIndex < problemCount; problemIndex++)
+}
+
+// The worker exits once it has drained the queue
+void stopPlotWorker()
+{
+    if(!plotQueue)
+        return;
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "%s/stop", plotQueue);
+    fclose(fopen(buffer, "w"));
+}
+
+void printProblem(Sprites sprites, FILE *manifest)
+{
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "data/problems/%s.csv", sprites.name);
+    FILE *file = fopen(buffer, "w");
+    spritePacking_printProblem(sprites.width, sprites.height, sprites.indexes, file);
+    fclose(file);
+    fprintf(manifest, "problem,%s\n", buffer);
+}
+
+typedef enum
+{
+    ALGORITHM_RANDOM,
+    ALGORITHM_GENETIC,
+    ALGORITHM_ANNEALING,
+    ALGORITHM_NSGA,
+}Algorithm;
+
+// One configuration of the sweep, run on every problem and replicate
+typedef struct
+{
+    char *folderName;
+    Algorithm algorithm;
+    SpritePackerSettings packerSettings;
+    union
     {
-        Problem *problem = &problems[problemIndex];
-        spritePacking_setSettings(problem, packerSettings);
-        snprintf(buffer, sizeof(buffer), "data/%s/scores/%s_0.csv", folderName, problem->name);
-        randomSettings.scoreFile = fopen(buffer, "w");
-        snprintf(buffer, sizeof(buffer), "data/%s/best/%s_0.csv", folderName, problem->name);
-        randomSettings.bestResultFile = fopen(buffer, "w");
-        fprintf(randomSettings.scoreFile, "optimum\n");
-        fprintf(randomSettings.scoreFile, "%i\n", problem->width * problem->height);
-        random_run(problem, &randomSettings);
-        fclose(randomSettings.scoreFile);
-        fclose(randomSettings.bestResultFile);
+        RandomSettings random;
+        GeneticSettings genetic;
+        AnnealingSettings annealing;
+        NsgaSettings nsga;
+    };
+    int remainingRuns; // plots are queued once all runs finished
+}Experiment;
+
+typedef struct
+{
+    Experiment *experiment;
+    Problem *problem;
+    int replicate;
+}Run;
+
+typedef struct
+{
+    Run *runs;
+    RunResult *results;
+    double *seconds;
+    int runCount;
+}Sweep;
+
+static int replicateCount = 1;
+static int processCount; // 0 uses every core
+
+static uint64_t maxIteration(Experiment *experiment)
+{
+    switch(experiment->algorithm)
+    {
+        case ALGORITHM_RANDOM:
+            return experiment->random.maxIteration;
+        case ALGORITHM_GENETIC:
+            return experiment->genetic.maxIteration;
+        case ALGORITHM_ANNEALING:
+            return experiment->annealing.maxIteration;
+        case ALGORITHM_NSGA:
+            return experiment->nsga.maxIteration;
+        default:
+            assert(false);
+            return 0;
     }
-    snprintf(buffer, sizeof(buffer), "python3 source/graph.py data/%s/scores", folderName);
-    system(buffer);
-    snprintf(buffer, sizeof(buffer), "python3 source/graph.py data/%s/best -t image", folderName);
-    system(buffer);
 }
 
-void evaluateGenetic(Problem *problems, 
-                     int problemCount,
-                     char *folderName,
-                     SpritePackerSettings packerSettings, 
-                     GeneticSettings geneticSettings)
+// Evaluations times the canvas they scan, only the order matters
+static double runCost(Run *run)
+{
+    return (double)maxIteration(run->experiment) * run->problem->width * run->problem->height;
+}
+
+static void runPath(char *buffer, size_t size, Experiment *experiment, Problem *problem, 
+                    int replicate, char *directory, char *suffix)
+{
+    snprintf(buffer, size, "data/%s/%s/%s_%i%s", experiment->folderName, directory, 
+             problem->name, replicate, suffix);
+}
+
+// Paths are known up front, so the manifest is complete before any run starts
+void writeManifest(Experiment *experiment, Problem *problems, int problemCount)
 {
     char buffer[512];
-    snprintf(buffer, sizeof(buffer), "mkdir -p data/%s/scores", folderName);
-    system(buffer);
-    snprintf(buffer, sizeof(buffer), "mkdir -p data/%s/best", folderName);
+    snprintf(buffer, sizeof(buffer), "mkdir -p data/%s/scores data/%s/best", 
+             experiment->folderName, experiment->folderName);
     system(buffer);
+    if(experiment->algorithm == ALGORITHM_NSGA)
+    {
+        snprintf(buffer, sizeof(buffer), "mkdir -p data/%s/front", experiment->folderName);
+        system(buffer);
+    }
+    if(experiment->algorithm == ALGORITHM_GENETIC)
+    {
+        snprintf(buffer, sizeof(buffer), "mkdir -p data/%s/stats", experiment->folderName);
+        system(buffer);
+    }
+    FILE *manifest = openManifest(experiment->folderName);
     for(int problemIndex = 0; problemIndex < problemCount; problemIndex++)
     {
-        Problem *problem = &problems[problemIndex];
-        spritePacking_setSettings(problem, packerSettings);
-        snprintf(buffer, sizeof(buffer), "data/%s/scores/%s_0.csv", folderName, problem->name);
-        geneticSettings.scoreFile = fopen(buffer, "w");
-        snprintf(buffer, sizeof(buffer), "data/%s/best/%s_0.csv", folderName, problem->name);
-        geneticSettings.bestResultFile = fopen(buffer, "w");
-        fprintf(geneticSettings.scoreFile, "optimum\n");
-        fprintf(geneticSettings.scoreFile, "%i\n", problem->width * problem->height);
-        genetic_run(problem, &geneticSettings);
-        fclose(geneticSettings.scoreFile);
-        fclose(geneticSettings.bestResultFile);
+        for(int replicate = 0; replicate < replicateCount; replicate++)
+        {
+            Problem *problem = &problems[problemIndex];
+            runPath(buffer, sizeof(buffer), experiment, problem, replicate, "scores", ".csv");
+            fprintf(manifest, "scores,%s\n", buffer);
+            runPath(buffer, sizeof(buffer), experiment, problem, replicate, "best", ".csv");
+            fprintf(manifest, "best,%s\n", buffer);
+            runPath(buffer, sizeof(buffer), experiment, problem, replicate, "best", "_atlas.png");
+            fprintf(manifest, "image,%s\n", buffer);
+            if(experiment->algorithm == ALGORITHM_GENETIC)
+            {
+                runPath(buffer, sizeof(buffer), experiment, problem, replicate, "stats", ".csv");
+                fprintf(manifest, "stats,%s\n", buffer);
+            }
+            if(experiment->algorithm == ALGORITHM_NSGA)
+            {
+                runPath(buffer, sizeof(buffer), experiment, problem, replicate, "front", ".csv");
+                fprintf(manifest, "front,%s\n", buffer);
+            }
+        }
     }
-    snprintf(buffer, sizeof(buffer), "python3 source/graph.py data/%s/scores", folderName);
-    system(buffer);
-    snprintf(buffer, sizeof(buffer), "python3 source/graph.py data/%s/best -t image", folderName);
-    system(buffer);
+    fclose(manifest);
 }
 
-int main()
+RunResult runExperiment(void *data, int index)
 {
+    Run *run = &((Sweep *)data)->runs[index];
+    Experiment *experiment = run->experiment;
+    Problem *problem = run->problem;
     char buffer[512];
+    char frontLayoutPath[512];
+    // Replicate 0 starts from the default pcg32 state
+    pcg32_srandom(42 + run->replicate, 54);
+    spritePacking_setSettings(problem, experiment->packerSettings);
+    runPath(buffer, sizeof(buffer), experiment, problem, run->replicate, "scores", ".csv");
+    FILE *scoreFile = fopen(buffer, "w");
+    runPath(buffer, sizeof(buffer), experiment, problem, run->replicate, "best", ".csv");
+    FILE *bestResultFile = fopen(buffer, "w");
+    runPath(buffer, sizeof(buffer), experiment, problem, run->replicate, "best", "_atlas.png");
+    FILE *bestImageFile = fopen(buffer, "wb");
+    // The lower bound is optional, graph.py only plots the columns it finds
+    if(problem->lowerBound)
+        fprintf(scoreFile, "optimum,lowerBound\n%i, %i\n", problem->width * problem->height,
+                problem->lowerBound(problem));
+    else
+        fprintf(scoreFile, "optimum\n%i\n", problem->width * problem->height);
+    RunResult result;
+    switch(experiment->algorithm)
+    {
+        case ALGORITHM_RANDOM:
+        {
+            RandomSettings settings = experiment->random;
+            settings.scoreFile = scoreFile;
+            settings.bestResultFile = bestResultFile;
+            settings.bestImageFile = bestImageFile;
+            result = random_run(problem, &settings);
+            break;
+        }
+        case ALGORITHM_GENETIC:
+        {
+            GeneticSettings settings = experiment->genetic;
+            settings.scoreFile = scoreFile;
+            settings.bestResultFile = bestResultFile;
+            settings.bestImageFile = bestImageFile;
+            runPath(buffer, sizeof(buffer), experiment, problem, run->replicate, "stats", ".csv");
+            settings.statsFile = fopen(buffer, "w");
+            result = genetic_run(problem, &settings);
+            fclose(settings.statsFile);
+            break;
+        }
+        case ALGORITHM_ANNEALING:
+        {
+            AnnealingSettings settings = experiment->annealing;
+            settings.scoreFile = scoreFile;
+            settings.bestResultFile = bestResultFile;
+            settings.bestImageFile = bestImageFile;
+            result = annealing_run(problem, &settings);
+            break;
+        }
+        case ALGORITHM_NSGA:
+        {
+            NsgaSettings settings = experiment->nsga;
+            settings.scoreFile = scoreFile;
+            settings.bestResultFile = bestResultFile;
+            settings.bestImageFile = bestImageFile;
+            runPath(buffer, sizeof(buffer), experiment, problem, run->replicate, "front", ".csv");
+            settings.frontFile = fopen(buffer, "w");
+            runPath(frontLayoutPath, sizeof(frontLayoutPath), experiment, problem, 
+                    run->replicate, "front", "_layout%i.csv");
+            settings.frontLayoutPath = frontLayoutPath;
+            result = nsga_run(problem, &settings);
+            fclose(settings.frontFile);
+            break;
+        }
+        default:
+            assert(false);
+    }
+    fclose(scoreFile);
+    fclose(bestResultFile);
+    fclose(bestImageFile);
+    return result;
+}
+
+static void runFinished(void *data, int index, RunResult result, double seconds)
+{
+    Sweep *sweep = (Sweep *)data;
+    sweep->results[index] = result;
+    sweep->seconds[index] = seconds;
+    Experiment *experiment = sweep->runs[index].experiment;
+    experiment->remainingRuns--;
+    if(experiment->remainingRuns == 0)
+        queuePlots(experiment->folderName);
+}
+
+// Replicates of one experiment and problem are consecutive runs
+void printSummary(Sweep *sweep, FILE *file)
+{
+    fprintf(file, "experiment,problem,runs,failed,best,mean,worst,lowerBound,meanGap,seconds\n");
+    for(int first = 0; first < sweep->runCount; first += replicateCount)
+    {
+        Run *run = &sweep->runs[first];
+        int failed = 0;
+        int best = INT_MAX;
+        int worst = 0;
+        double sum = 0;
+        double seconds = 0;
+        for(int i = first; i < first + replicateCount; i++)
+        {
+            RunResult result = sweep->results[i];
+            seconds += sweep->seconds[i];
+            if(result.bestScore == INT_MAX)
+            {
+                failed++;
+                continue;
+            }
+            best = MIN(best, result.bestScore);
+            worst = MAX(worst, result.bestScore);
+            sum += result.bestScore;
+        }
+        int valid = replicateCount - failed;
+        double mean = valid ? sum / valid : 0;
+        int lowerBound = sweep->results[first].lowerBound;
+        fprintf(file, "%s, %s, %i, %i, %i, %.1f, %i, %i, %.4f, %.2f\n",
+                run->experiment->folderName, run->problem->name, replicateCount, failed,
+                valid ? best : 0, mean, worst, lowerBound, 
+                valid && lowerBound ? mean / lowerBound - 1 : 0, seconds / replicateCount);
+    }
+}
+
+void runSweep(Experiment *experiments, int experimentCount, Problem *problems, int problemCount)
+{
+    Sweep sweep = {.runCount = experimentCount * problemCount * replicateCount};
+    sweep.runs = malloc(sweep.runCount * sizeof (Run));
+    sweep.results = calloc(sweep.runCount, sizeof (RunResult));
+    sweep.seconds = calloc(sweep.runCount, sizeof (double));
+    double *costs = malloc(sweep.runCount * sizeof (double));
+    Run *run = sweep.runs;
+    for(int i = 0; i < experimentCount; i++)
+    {
+        writeManifest(&experiments[i], problems, problemCount);
+        experiments[i].remainingRuns = problemCount * replicateCount;
+        for(int problemIndex = 0; problemIndex < problemCount; problemIndex++)
+        {
+            for(int replicate = 0; replicate < replicateCount; replicate++)
+            {
+                *run = (Run){&experiments[i], &problems[problemIndex], replicate};
+                costs[run - sweep.runs] = runCost(run);
+                run++;
+            }
+        }
+    }
+    sweep_run(sweep.runCount, processCount ? processCount : parallel_coreCount(), costs,
+              runExperiment, runFinished, &sweep);
+    FILE *summary = fopen("data/summary.csv", "w");
+    printSummary(&sweep, summary);
+    fclose(summary);
+    printSummary(&sweep, stdout);
+    free(costs);
+    free(sweep.runs);
+    free(sweep.results);
+    free(sweep.seconds);
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--no-plots") == 0)
+            plotQueue = NULL;
+        else if(strcmp(argv[i], "--plot-queue") == 0 && i + 1 < argc)
+            plotQueue = argv[++i];
+        else if(strcmp(argv[i], "--replicates") == 0 && i + 1 < argc)
+            replicateCount = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--processes") == 0 && i + 1 < argc)
+            processCount = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--no-plots] [--plot-queue directory] "
+                    "[--replicates count] [--processes count]\n", argv[0]);
+            return 1;
+        }
+    }
+    replicateCount = MAX(replicateCount, 1);
+    startPlotWorker();
     Problem problems[3] = 
     {
         spritePacking_createProblemFromIndexes(SPRITES(Box0)),
@@ -102,71 +392,202 @@ int main()
         spritePacking_createProblemFromIndexes(SPRITES(Blob1))
     };
 
-    printProblem(SPRITES(Box0));
-    printProblem(SPRITES(Box1));
-    printProblem(SPRITES(Box2));
-    printProblem(SPRITES(Blob1));
-    system("python3 source/graph.py data/problems/ -t image --info");
+    system("mkdir -p data/problems");
+    FILE *manifest = openManifest("problems");
+    printProblem(SPRITES(Box0), manifest);
+    printProblem(SPRITES(Box1), manifest);
+    printProblem(SPRITES(Box2), manifest);
+    printProblem(SPRITES(Blob1), manifest);
+    fclose(manifest);
+    queuePlots("problems");
 
-    evaluateRandom(problems, array_length(problems), "random_noError",
-            (SpritePackerSettings) {
+    Experiment experiments[] =
+    {
+        {
+            .folderName = "random_noError",
+            .algorithm = ALGORITHM_RANDOM,
+            .packerSettings = {
                 .positionEncoding = POS_CARTESIAN,
                 .disableErrorTerm = true},
-            (RandomSettings) {
+            .random = {
+                .maxIteration = 15000,
+            },
+        },
+        {
+            .folderName = "random",
+            .algorithm = ALGORITHM_RANDOM,
+            .packerSettings = {.positionEncoding = POS_CARTESIAN},
+            .random = {
                 .maxIteration = 15000,
-            });
-    evaluateRandom(problems, array_length(problems), "random",
-            (SpritePackerSettings) {.positionEncoding = POS_CARTESIAN},
-            (RandomSettings) {
+            },
+        },
+        {
+            .folderName = "random_dir",
+            .algorithm = ALGORITHM_RANDOM,
+            .packerSettings = {.positionEncoding = MOV_DIRECTION},
+            .random = {
                 .maxIteration = 15000,
-            });
-    evaluateRandom(problems, array_length(problems), "random_dir",
-            (SpritePackerSettings) {.positionEncoding = MOV_DIRECTION},
-            (RandomSettings) {
+            },
+        },
+        {
+            .folderName = "mGA",
+            .algorithm = ALGORITHM_GENETIC,
+            .packerSettings = {.positionEncoding = POS_CARTESIAN },
+            .genetic = {
                 .maxIteration = 15000,
-            });
-    evaluateGenetic(problems, array_length(problems), "mGA",
-        (SpritePackerSettings) {.positionEncoding = POS_CARTESIAN },
-        (GeneticSettings) {
-            .maxIteration = 15000,
-            .populationSize = 5,
-            .eliteCount = 1,
-            .randomSelection = true,
-            .mutationRate = 0,
-            .restartWhenSameScore = true,
-        });
-    evaluateGenetic(problems, array_length(problems), "GA",
-        (SpritePackerSettings) {.positionEncoding = POS_CARTESIAN },
-        (GeneticSettings) {
-            .maxIteration = 15000,
-            .populationSize = 100,
-            .eliteCount = 5,
-            .mutationRate = .1,
-            .mutationDistance = .1,
-            .restartProbability = 1./1500,
-            .restartWhenSameScore = true,
-        });
-    evaluateGenetic(problems, array_length(problems), "GA_dir",
-        (SpritePackerSettings) {.positionEncoding = MOV_DIRECTION },
-        (GeneticSettings) {
-            .maxIteration = 15000,
-            .populationSize = 100,
-            .eliteCount = 5,
-            .mutationRate = 0.05,
-            .mutationDistance = 0.3,
-            .restartProbability = 1./1500,
-            .restartWhenSameScore = true,
-        });
-    evaluateGenetic(problems, array_length(problems), "GA_mov",
-        (SpritePackerSettings) {.positionEncoding = MOV_CARTESIAN },
-        (GeneticSettings) {
-            .maxIteration = 15000,
-            .populationSize = 100,
-            .eliteCount = 5,
-            .mutationRate = 0.05,
-            .mutationDistance = 0.3,
-            .restartProbability = 1./1000,
-            .restartWhenSameScore = true,
-        });
+                .populationSize = 5,
+                .eliteCount = 1,
+                .randomSelection = true,
+                .mutationRate = 0,
+                .restartWhenSameScore = true,
+            },
+        },
+        {
+            .folderName = "GA",
+            .algorithm = ALGORITHM_GENETIC,
+            .packerSettings = {.positionEncoding = POS_CARTESIAN },
+            .genetic = {
+                .maxIteration = 15000,
+                .populationSize = 100,
+                .eliteCount = 5,
+                .mutationRate = .1,
+                .mutationDistance = .1,
+                .restartProbability = 1./1500,
+                .restartWhenSameScore = true,
+            },
+        },
+        {
+            .folderName = "GA_region",
+            .algorithm = ALGORITHM_GENETIC,
+            .packerSettings = {
+                .positionEncoding = POS_CARTESIAN,
+                .crossover = CROSSOVER_REGION},
+            .genetic = {
+                .maxIteration = 15000,
+                .populationSize = 100,
+                .eliteCount = 5,
+                .mutationRate = .1,
+                .mutationDistance = .1,
+                .restartProbability = 1./1500,
+                .restartWhenSameScore = true,
+            },
+        },
+        {
+            .folderName = "GA_dir",
+            .algorithm = ALGORITHM_GENETIC,
+            .packerSettings = {.positionEncoding = MOV_DIRECTION },
+            .genetic = {
+                .maxIteration = 15000,
+                .populationSize = 100,
+                .eliteCount = 5,
+                .mutationRate = 0.05,
+                .mutationDistance = 0.3,
+                .restartProbability = 1./1500,
+                .restartWhenSameScore = true,
+            },
+        },
+        {
+            .folderName = "GA_mov",
+            .algorithm = ALGORITHM_GENETIC,
+            .packerSettings = {.positionEncoding = MOV_CARTESIAN },
+            .genetic = {
+                .maxIteration = 15000,
+                .populationSize = 100,
+                .eliteCount = 5,
+                .mutationRate = 0.05,
+                .mutationDistance = 0.3,
+                .restartProbability = 1./1000,
+                .restartWhenSameScore = true,
+            },
+        },
+        {
+            .folderName = "GA_diversity",
+            .algorithm = ALGORITHM_GENETIC,
+            .packerSettings = {.positionEncoding = MOV_DIRECTION },
+            .genetic = {
+                .maxIteration = 15000,
+                .populationSize = 100,
+                .eliteCount = 5,
+                .mutationRate = 0.05,
+                .mutationDistance = 0.3,
+                .restartDiversity = 0.2,
+                .restartFraction = 0.5,
+            },
+        },
+        {
+            .folderName = "GA_self",
+            .algorithm = ALGORITHM_GENETIC,
+            .packerSettings = {.positionEncoding = MOV_DIRECTION },
+            .genetic = {
+                .maxIteration = 15000,
+                .populationSize = 100,
+                .eliteCount = 5,
+                .mutationRate = 0.1,
+                .mutationDistance = 0.1,
+                .adaptation = ADAPT_SELF,
+                .restartProbability = 1./1500,
+                .restartWhenSameScore = true,
+            },
+        },
+        {
+            .folderName = "SA_dir",
+            .algorithm = ALGORITHM_ANNEALING,
+            .packerSettings = {
+                .positionEncoding = MOV_DIRECTION,
+                .decodeCacheSize = 4,
+                .decodeCacheInterval = 4},
+            .annealing = {
+                .maxIteration = 15000,
+                .acceptance = ACCEPT_ANNEALING,
+                .startTemperature = 0.05,
+                .endTemperature = 0.0005,
+                .chainCount = 1,
+            },
+        },
+        {
+            .folderName = "LAHC_dir",
+            .algorithm = ALGORITHM_ANNEALING,
+            .packerSettings = {
+                .positionEncoding = MOV_DIRECTION,
+                .decodeCacheSize = 4,
+                .decodeCacheInterval = 4},
+            .annealing = {
+                .maxIteration = 15000,
+                .acceptance = ACCEPT_LATE,
+                .lateAcceptanceLength = 50,
+                .chainCount = 1,
+            },
+        },
+        {
+            .folderName = "NSGA_dir",
+            .algorithm = ALGORITHM_NSGA,
+            .packerSettings = {.positionEncoding = MOV_DIRECTION },
+            .nsga = {
+                .maxIteration = 15000,
+                .populationSize = 100,
+                .mutationRate = 0.05,
+                .mutationDistance = 0.3,
+                .objectiveCount = 3,
+                .objectives = {OBJECTIVE_AREA, OBJECTIVE_POW2_AREA, OBJECTIVE_ASPECT},
+            },
+        },
+        {
+            .folderName = "SA_pages",
+            .algorithm = ALGORITHM_ANNEALING,
+            .packerSettings = {
+                .positionEncoding = MOV_DIRECTION,
+                .pageSize = {.x = 64, .y = 64},
+                .pageCount = 3},
+            .annealing = {
+                .maxIteration = 15000,
+                .acceptance = ACCEPT_ANNEALING,
+                .startTemperature = 0.05,
+                .endTemperature = 0.0005,
+                .chainCount = 1,
+            },
+        },
+    };
+    runSweep(experiments, array_length(experiments), problems, array_length(problems));
+    stopPlotWorker();
     return 0;
 }
@@ -0,0 +1,465 @@
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "problem.h"
+#include "profile.h"
+#include "nsga.h"
+#include "pcg_basic.h"
+
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+#define MAX(A, B) ((A) > (B) ? (A) : (B))
+
+typedef struct
+{
+    void *chromosom;
+    Score score;
+    double objectives[OBJECTIVE_COUNT];
+    int violation; // overlap, zero for valid layouts
+    int rank;
+    double crowding;
+    int previousInFront; // position in the sort order, -1 ends the front
+}Individual;
+
+typedef struct
+{
+    Problem *problem;
+    NsgaSettings *settings;
+    Individual *individuals; // parents followed by their offspring
+    Individual *selected;
+    int *order; // sort order of individuals, grouped by front afterwards
+    int *sortedFront;
+    int *frontLast;
+    int *frontSize;
+    void **batch;
+    Score *scores;
+    void *best;
+    int bestScore;
+    int lowerBound;
+    uint64_t iteration;
+}Context;
+
+static char *objectiveNames[OBJECTIVE_COUNT] =
+{
+    [OBJECTIVE_AREA]      = "area",
+    [OBJECTIVE_ASPECT]    = "aspect",
+    [OBJECTIVE_POW2_AREA] = "pow2Area",
+    [OBJECTIVE_MAX_EDGE]  = "maxEdge",
+};
+
+static int nextPowerOfTwo(int value)
+{
+    int result = 1;
+    while(result < value)
+        result *= 2;
+    return result;
+}
+
+static double objective_value(Objective objective, Score score)
+{
+    int longer = MAX(score.width, score.height);
+    int shorter = MAX(MIN(score.width, score.height), 1);
+    switch(objective)
+    {
+        case OBJECTIVE_AREA:
+            return score.score;
+        case OBJECTIVE_ASPECT:
+            return (double)longer / shorter;
+        case OBJECTIVE_POW2_AREA:
+            return (double)nextPowerOfTwo(score.width) * nextPowerOfTwo(score.height);
+        case OBJECTIVE_MAX_EDGE:
+            return longer;
+        default:
+            assert(false);
+            return 0;
+    }
+}
+
+static void printScore(Context *context, Individual *individual, Score score)
+{
+    NsgaSettings *settings = context->settings;
+    individual->score = score;
+    individual->violation = score.overlap;
+    for(int i = 0; i < settings->objectiveCount; i++)
+        individual->objectives[i] = objective_value(settings->objectives[i], score);
+    PROFILE_BEGIN(PHASE_TRACE_IO);
+    if(settings->scoreFile)
+        fprintf(settings->scoreFile, "%li, %i, %i, %i, %i\n",
+                context->iteration, score.score, score.rawScore, score.overlap,
+                score.rejected);
+    if(settings->profileFile && context->iteration % settings->profileInterval == 0)
+        profile_printSample(settings->profileFile, context->iteration);
+    PROFILE_END(PHASE_TRACE_IO);
+    if(score.overlap == 0 && context->bestScore > score.score)
+    {
+        memcpy(context->best, individual->chromosom, context->problem->chromosomSize);
+        context->bestScore = score.score;
+    }
+    context->iteration++;
+}
+
+static void calculateAndPrintScores(Context *context, Individual *individuals, int count)
+{
+    Problem *problem = context->problem;
+    if(!problem->calculateScoreBatch)
+    {
+        for(int i = 0; i < count; i++)
+            printScore(context, individuals + i,
+                       problem->calculateScore(problem, individuals[i].chromosom, INT_MAX));
+        return;
+    }
+    for(int i = 0; i < count; i++)
+        context->batch[i] = individuals[i].chromosom;
+    problem->calculateScoreBatch(problem, context->batch, count, INT_MAX, context->scores);
+    for(int i = 0; i < count; i++)
+        printScore(context, individuals + i, context->scores[i]);
+}
+
+static void printCSVHeader(Context *context)
+{
+    if(context->settings->scoreFile)
+        fprintf(context->settings->scoreFile, "iteration,score,rawScore,overlap,rejected\n");
+    if(context->settings->profileFile)
+        profile_printSampleHeader(context->settings->profileFile);
+}
+
+// Constrained domination: less overlap dominates, equal overlap falls back
+// to Pareto dominance over the objectives.
+static bool dominates(Individual *a, Individual *b, int objectiveCount)
+{
+    if(a->violation != b->violation)
+        return a->violation < b->violation;
+    bool better = false;
+    for(int i = 0; i < objectiveCount; i++)
+    {
+        if(a->objectives[i] > b->objectives[i])
+            return false;
+        better |= a->objectives[i] < b->objectives[i];
+    }
+    return better;
+}
+
+// qsort has no context argument, the sorts only run on the calling thread
+static _Thread_local Individual *compareIndividuals;
+static _Thread_local int compareObjectiveCount;
+static _Thread_local int compareObjective;
+
+static int compareLexicographic(const void *a, const void *b)
+{
+    Individual *first = compareIndividuals + *(int *)a;
+    Individual *second = compareIndividuals + *(int *)b;
+    if(first->violation != second->violation)
+        return first->violation < second->violation ? -1 : 1;
+    for(int i = 0; i < compareObjectiveCount; i++)
+        if(first->objectives[i] != second->objectives[i])
+            return first->objectives[i] < second->objectives[i] ? -1 : 1;
+    return 0;
+}
+
+static int compareObjectiveValue(const void *a, const void *b)
+{
+    double first = compareIndividuals[*(int *)a].objectives[compareObjective];
+    double second = compareIndividuals[*(int *)b].objectives[compareObjective];
+    return (first > second) - (first < second);
+}
+
+static int compareCrowdingDesc(const void *a, const void *b)
+{
+    double first = compareIndividuals[*(int *)a].crowding;
+    double second = compareIndividuals[*(int *)b].crowding;
+    return (first < second) - (first > second);
+}
+
+// With up to two objectives the members of a front, in lexicographic order, 
+// have falling second objectives and share the violation. The last one added 
+// dominates the individual if any member does.
+static bool frontDominates(Context *context, int front, Individual *individual)
+{
+    int objectiveCount = context->settings->objectiveCount;
+    if(objectiveCount <= 2)
+        return dominates(context->individuals + context->frontLast[front], 
+                         individual, objectiveCount);
+    for(int i = context->frontLast[front]; i >= 0;
+        i = context->individuals[i].previousInFront)
+    {
+        if(dominates(context->individuals + i, individual, objectiveCount))
+            return true;
+    }
+    return false;
+}
+
+// Efficient non-dominated sort with binary search (ENS-BS). After a
+// lexicographic sort no individual can be dominated by a later one, so every
+// individual only needs to be compared with the fronts built so far. An
+// individual dominated by front k is dominated by all fronts before k, which
+// allows a binary search for its front. With two objectives every probe is a
+// single comparison, which makes the sort O(N log N). With more every probe 
+// compares against the members of one front, so the worst case, a single 
+// front, is O(MN^2). Many small fronts come close to O(MN log N).
+// Leaves context->order grouped by front and returns the number of fronts.
+static int nonDominatedSort(Context *context, int count)
+{
+    Individual *individuals = context->individuals;
+    int *order = context->order;
+    for(int i = 0; i < count; i++)
+        order[i] = i;
+    compareIndividuals = individuals;
+    compareObjectiveCount = context->settings->objectiveCount;
+    qsort(order, count, sizeof (int), compareLexicographic);
+
+    int frontCount = 0;
+    for(int i = 0; i < count; i++)
+    {
+        Individual *individual = individuals + order[i];
+        int low = 0;
+        int high = frontCount;
+        while(low < high)
+        {
+            int middle = (low + high) / 2;
+            if(frontDominates(context, middle, individual))
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if(low == frontCount)
+        {
+            context->frontLast[frontCount] = -1;
+            context->frontSize[frontCount] = 0;
+            frontCount++;
+        }
+        individual->rank = low;
+        individual->previousInFront = context->frontLast[low];
+        context->frontLast[low] = order[i];
+        context->frontSize[low]++;
+    }
+
+    int position = 0;
+    for(int front = 0; front < frontCount; front++)
+    {
+        position += context->frontSize[front];
+        int next = position;
+        for(int i = context->frontLast[front]; i >= 0; i = individuals[i].previousInFront)
+            order[--next] = i;
+    }
+    return frontCount;
+}
+
+static void crowdingDistance(Context *context, int *front, int size)
+{
+    Individual *individuals = context->individuals;
+    for(int i = 0; i < size; i++)
+        individuals[front[i]].crowding = size <= 2 ? INFINITY : 0;
+    if(size <= 2)
+        return;
+    int *sorted = context->sortedFront;
+    memcpy(sorted, front, size * sizeof (int));
+    compareIndividuals = individuals;
+    for(int objective = 0; objective < context->settings->objectiveCount; objective++)
+    {
+        compareObjective = objective;
+        qsort(sorted, size, sizeof (int), compareObjectiveValue);
+        double low = individuals[sorted[0]].objectives[objective];
+        double high = individuals[sorted[size - 1]].objectives[objective];
+        individuals[sorted[0]].crowding = INFINITY;
+        individuals[sorted[size - 1]].crowding = INFINITY;
+        if(high <= low)
+            continue;
+        for(int i = 1; i < size - 1; i++)
+            individuals[sorted[i]].crowding +=
+                (individuals[sorted[i + 1]].objectives[objective] -
+                 individuals[sorted[i - 1]].objectives[objective]) / (high - low);
+    }
+}
+
+static void rankPopulation(Context *context, int count)
+{
+    int frontCount = nonDominatedSort(context, count);
+    int *front = context->order;
+    for(int i = 0; i < frontCount; i++)
+    {
+        crowdingDistance(context, front, context->frontSize[i]);
+        front += context->frontSize[i];
+    }
+}
+
+// Keeps the best populationSize individuals by front and crowding distance.
+// The others stay behind them, their chromosomes hold the next offspring.
+static void selectSurvivors(Context *context)
+{
+    int populationSize = context->settings->populationSize;
+    int count = populationSize * 2;
+    int *order = context->order;
+    rankPopulation(context, count);
+    int start = 0;
+    for(int front = 0; start < populationSize; front++)
+    {
+        int size = context->frontSize[front];
+        if(start + size > populationSize)
+        {
+            compareIndividuals = context->individuals;
+            qsort(order + start, size, sizeof (int), compareCrowdingDesc);
+        }
+        start += size;
+    }
+    for(int i = 0; i < count; i++)
+        context->selected[i] = context->individuals[order[i]];
+    Individual *tmp = context->individuals;
+    context->individuals = context->selected;
+    context->selected = tmp;
+}
+
+static Individual *tournament(Context *context)
+{
+    int populationSize = context->settings->populationSize;
+    Individual *a = context->individuals + pcg32_boundedrand(populationSize);
+    Individual *b = context->individuals + pcg32_boundedrand(populationSize);
+    if(a->rank != b->rank)
+        return a->rank < b->rank ? a : b;
+    return a->crowding >= b->crowding ? a : b;
+}
+
+static void nsga_step(Context *context)
+{
+    Problem *problem = context->problem;
+    NsgaSettings *settings = context->settings;
+    Individual *offspring = context->individuals + settings->populationSize;
+    for(int i = 0; i < settings->populationSize; i += 2)
+    {
+        PROFILE_BEGIN(PHASE_SELECTION);
+        Individual *mother = tournament(context);
+        Individual *father = tournament(context);
+        PROFILE_END(PHASE_SELECTION);
+        problem->crossover(problem, mother->chromosom, father->chromosom,
+                           offspring[i].chromosom, offspring[i+1].chromosom);
+        problem->mutate(problem, settings->mutationRate,
+                        settings->mutationDistance, offspring[i].chromosom);
+        problem->mutate(problem, settings->mutationRate,
+                        settings->mutationDistance, offspring[i+1].chromosom);
+    }
+    calculateAndPrintScores(context, offspring, settings->populationSize);
+    PROFILE_BEGIN(PHASE_SELECTION);
+    selectSurvivors(context);
+    PROFILE_END(PHASE_SELECTION);
+}
+
+static bool sameObjectives(Individual *a, Individual *b, int objectiveCount)
+{
+    return memcmp(a->objectives, b->objectives, objectiveCount * sizeof (double)) == 0;
+}
+
+// Writes the valid individuals of the first front, without duplicates
+static void printFront(Context *context)
+{
+    Problem *problem = context->problem;
+    NsgaSettings *settings = context->settings;
+    int objectiveCount = settings->objectiveCount;
+    rankPopulation(context, settings->populationSize);
+    int size = context->frontSize[0];
+    int *front = context->order;
+    compareIndividuals = context->individuals;
+    compareObjectiveCount = objectiveCount;
+    qsort(front, size, sizeof (int), compareLexicographic);
+    if(settings->frontFile)
+    {
+        for(int i = 0; i < objectiveCount; i++)
+            fprintf(settings->frontFile, "%s,", objectiveNames[settings->objectives[i]]);
+        fprintf(settings->frontFile, "width,height\n");
+    }
+    int printed = 0;
+    for(int i = 0; i < size; i++)
+    {
+        Individual *individual = context->individuals + front[i];
+        if(individual->violation > 0 ||
+           (i > 0 && sameObjectives(individual, context->individuals + front[i - 1],
+                                    objectiveCount)))
+            continue;
+        if(settings->frontFile)
+        {
+            for(int j = 0; j < objectiveCount; j++)
+                fprintf(settings->frontFile, "%g, ", individual->objectives[j]);
+            fprintf(settings->frontFile, "%i, %i\n",
+                    individual->score.width, individual->score.height);
+        }
+        if(settings->frontLayoutPath && problem->printChromosom)
+        {
+            char buffer[512];
+            snprintf(buffer, sizeof(buffer), settings->frontLayoutPath, printed);
+            FILE *file = fopen(buffer, "w");
+            assert(file);
+            problem->printChromosom(problem, individual->chromosom, file);
+            fclose(file);
+        }
+        printed++;
+    }
+    printf("%s: %i layouts on the pareto front\n", problem->name, printed);
+}
+
+RunResult nsga_run(Problem *problem, NsgaSettings *settings)
+{
+    assert(settings->objectiveCount > 0 && settings->objectiveCount <= OBJECTIVE_COUNT);
+    assert(settings->populationSize > 0 && settings->populationSize % 2 == 0);
+    assert(!settings->profileFile || settings->profileInterval > 0);
+    int count = settings->populationSize * 2;
+    Context context =
+    {
+        .problem = problem,
+        .settings = settings,
+        .individuals = calloc(count, sizeof (Individual)),
+        .selected    = calloc(count, sizeof (Individual)),
+        .order       = calloc(count, sizeof (int)),
+        .sortedFront = calloc(count, sizeof (int)),
+        .frontLast   = calloc(count, sizeof (int)),
+        .frontSize   = calloc(count, sizeof (int)),
+        .batch       = calloc(settings->populationSize, sizeof (void *)),
+        .scores      = calloc(settings->populationSize, sizeof (Score)),
+        .bestScore = INT_MAX,
+    };
+    profile_reset();
+    context.lowerBound = problem->lowerBound ? problem->lowerBound(problem) : 0;
+    printCSVHeader(&context);
+    char *chromosomes = malloc((count + 1) * problem->chromosomSize);
+    context.best = chromosomes;
+    for(int i = 0; i < count; i++)
+    {
+        chromosomes += problem->chromosomSize;
+        context.individuals[i].chromosom = chromosomes;
+        if(i < settings->populationSize)
+            problem->initializeChromosom(problem, chromosomes);
+    }
+    calculateAndPrintScores(&context, context.individuals, settings->populationSize);
+    rankPopulation(&context, settings->populationSize);
+
+    while(context.iteration < settings->maxIteration)
+    {
+        if(settings->stopAtLowerBound && context.bestScore <= context.lowerBound)
+            break;
+        nsga_step(&context);
+    }
+
+    if(problem->printChromosom && settings->bestResultFile && context.bestScore < INT_MAX)
+        problem->printChromosom(problem, context.best, settings->bestResultFile);
+    if(problem->writeImage && settings->bestImageFile && context.bestScore < INT_MAX)
+        problem->writeImage(problem, context.best, settings->bestImageFile);
+    printFront(&context);
+    profile_printSummary(stdout, problem->name);
+    problem_printGap(problem, context.bestScore, context.lowerBound);
+    RunResult result =
+    {
+        .bestScore = context.bestScore,
+        .lowerBound = context.lowerBound,
+        .iterations = context.iteration,
+    };
+    free(context.best);
+    free(context.individuals);
+    free(context.selected);
+    free(context.order);
+    free(context.sortedFront);
+    free(context.frontLast);
+    free(context.frontSize);
+    free(context.batch);
+    free(context.scores);
+    return result;
+}
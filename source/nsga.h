@@ -0,0 +1,38 @@
+#ifndef _NSGA_H
+#define _NSGA_H
+
+#include "problem.h"
+
+typedef enum
+{
+    OBJECTIVE_AREA,      // score, bounding box area plus overlap error
+    OBJECTIVE_ASPECT,    // longer over shorter edge of the bounding box
+    OBJECTIVE_POW2_AREA, // area of the smallest power of two texture
+    OBJECTIVE_MAX_EDGE,  // longer edge of the bounding box
+    OBJECTIVE_COUNT
+}Objective;
+
+typedef struct
+{
+    FILE *scoreFile;
+    FILE *bestResultFile; // layout with the smallest area on the front
+    FILE *bestImageFile; // image of the best layout, needs problem->writeImage
+    FILE *frontFile; // objectives of the final front
+    char *frontLayoutPath; // printf pattern with %i for every front layout
+    FILE *profileFile; // periodic profile samples, needs PROFILE
+    uint64_t profileInterval;
+    uint64_t maxIteration;
+    int populationSize;
+    float mutationRate;
+    float mutationDistance;
+    bool stopAtLowerBound; // stop once the smallest valid area reaches problem->lowerBound
+    int objectiveCount;
+    Objective objectives[OBJECTIVE_COUNT];
+}NsgaSettings;
+
+// NSGA-II: non-dominated sorting with crowding distance over the configured
+// objectives. Layouts with overlap are constraint violations, the one with
+// less overlap dominates. Returns the smallest area on the final front.
+RunResult nsga_run(Problem *problem, NsgaSettings *settings);
+
+#endif
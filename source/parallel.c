@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "parallel.h"
+#include "profile.h"
+
+typedef struct
+{
+    ParallelTask task;
+    void *data;
+    int taskCount;
+    int nextTask;
+}Pool;
+
+static void *worker(void *poolData)
+{
+    Pool *pool = (Pool *)poolData;
+    profile_begin();
+    for(;;)
+    {
+        int index = __atomic_fetch_add(&pool->nextTask, 1, __ATOMIC_RELAXED);
+        if(index >= pool->taskCount)
+            break;
+        pool->task(pool->data, index);
+    }
+    profile_merge();
+    return NULL;
+}
+
+void parallel_run(int taskCount, int threadCount, ParallelTask task, void *data)
+{
+    if(threadCount > taskCount)
+        threadCount = taskCount;
+    if(threadCount <= 1)
+    {
+        for(int i = 0; i < taskCount; i++)
+            task(data, i);
+        return;
+    }
+    Pool pool = 
+    {
+        .task = task,
+        .data = data,
+        .taskCount = taskCount,
+    };
+    pthread_t *threads = malloc(threadCount * sizeof (pthread_t));
+    for(int i = 0; i < threadCount; i++)
+        pthread_create(&threads[i], NULL, worker, &pool);
+    for(int i = 0; i < threadCount; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+int parallel_coreCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+}
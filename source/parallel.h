@@ -0,0 +1,12 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+// Runs task(data, index) for every index in [0, taskCount) on up to 
+// threadCount threads. Tasks are handed out in order as threads become free.
+// threadCount <= 1 runs everything on the calling thread.
+typedef void (*ParallelTask)(void *data, int index);
+
+void parallel_run(int taskCount, int threadCount, ParallelTask task, void *data);
+int parallel_coreCount(void);
+
+#endif
@@ -31,9 +31,9 @@
 #include <math.h>
 #include "pcg_basic.h"
 
-// state for global RNGs
+// state for global RNGs, every thread starts with its own copy
 
-static pcg32_random_t pcg32_global = PCG32_INITIALIZER;
+static _Thread_local pcg32_random_t pcg32_global = PCG32_INITIALIZER;
 
 // pcg32_srandom(initstate, initseq)
 // pcg32_srandom_r(rng, initstate, initseq):
@@ -58,6 +58,16 @@ void pcg32_srandom(uint64_t seed, uint64_t seq)
 // pcg32_random_r(rng)
 //     Generate a uniformly distributed 32-bit random number
 
+pcg32_random_t pcg32_getstate(void)
+{
+    return pcg32_global;
+}
+
+void pcg32_setstate(pcg32_random_t rng)
+{
+    pcg32_global = rng;
+}
+
 uint32_t pcg32_random_r(pcg32_random_t* rng)
 {
     uint64_t oldstate = rng->state;
@@ -57,6 +57,14 @@ void pcg32_srandom(uint64_t initstate, uint64_t initseq);
 void pcg32_srandom_r(pcg32_random_t* rng, uint64_t initstate,
                      uint64_t initseq);
 
+// pcg32_getstate()
+// pcg32_setstate(rng):
+//     Save and restore the global rng of the calling thread, e.g. for
+//     checkpoints
+
+pcg32_random_t pcg32_getstate(void);
+void pcg32_setstate(pcg32_random_t rng);
+
 // pcg32_random()
 // pcg32_random_r(rng)
 //     Generate a uniformly distributed 32-bit random number
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "png.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MAX_DISTANCE 32768
+
+static uint32_t crcTable[256];
+
+static void createCrcTable(void)
+{
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for(int k = 0; k < 8; k++)
+            crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        crcTable[i] = crc;
+    }
+}
+
+static uint32_t crc32(uint32_t crc, uint8_t *data, size_t length)
+{
+    crc = ~crc;
+    for(size_t i = 0; i < length; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t adler32(uint32_t adler, uint8_t *data, size_t length)
+{
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while(length > 0)
+    {
+        //Largest block that can't overflow b before the modulo
+        size_t block = length < 5552 ? length : 5552;
+        for(size_t i = 0; i < block; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        length -= block;
+    }
+    return (b << 16) | a;
+}
+
+static void putUint32(uint8_t *target, uint32_t value)
+{
+    target[0] = value >> 24;
+    target[1] = value >> 16;
+    target[2] = value >> 8;
+    target[3] = value;
+}
+
+static void writeChunk(FILE *file, char *type, uint8_t *data, uint32_t length)
+{
+    uint8_t header[8];
+    putUint32(header, length);
+    memcpy(header + 4, type, 4);
+    uint32_t crc = crc32(crc32(0, header + 4, 4), data, length);
+    uint8_t footer[4];
+    putUint32(footer, crc);
+    fwrite(header, 1, sizeof (header), file);
+    fwrite(data, 1, length, file);
+    fwrite(footer, 1, sizeof (footer), file);
+}
+
+typedef struct
+{
+    uint8_t *data;
+    size_t length;
+    uint32_t bits;
+    int bitCount;
+}BitWriter;
+
+// Deflate packs values least significant bit first
+static void putBits(BitWriter *writer, uint32_t value, int count)
+{
+    writer->bits |= value << writer->bitCount;
+    writer->bitCount += count;
+    while(writer->bitCount >= 8)
+    {
+        writer->data[writer->length++] = writer->bits;
+        writer->bits >>= 8;
+        writer->bitCount -= 8;
+    }
+}
+
+// Huffman codes are packed most significant bit first
+static void putCode(BitWriter *writer, uint32_t code, int count)
+{
+    uint32_t reversed = 0;
+    for(int i = 0; i < count; i++)
+        reversed |= (code >> i & 1) << (count - 1 - i);
+    putBits(writer, reversed, count);
+}
+
+// Literal and length symbol with the fixed Huffman code of RFC 1951 3.2.6
+static void putSymbol(BitWriter *writer, int symbol)
+{
+    if(symbol < 144)
+        putCode(writer, 0x30 + symbol, 8);
+    else if(symbol < 256)
+        putCode(writer, 0x190 + symbol - 144, 9);
+    else if(symbol < 280)
+        putCode(writer, symbol - 256, 7);
+    else
+        putCode(writer, 0xc0 + symbol - 280, 8);
+}
+
+static const int lengthBase[29] = 
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const int lengthExtra[29] = 
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const int distanceBase[30] = 
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const int distanceExtra[30] = 
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static void putMatch(BitWriter *writer, int length, int distance)
+{
+    int code = 28;
+    while(lengthBase[code] > length)
+        code--;
+    putSymbol(writer, 257 + code);
+    putBits(writer, length - lengthBase[code], lengthExtra[code]);
+    code = 29;
+    while(distanceBase[code] > distance)
+        code--;
+    putCode(writer, code, 5);
+    putBits(writer, distance - distanceBase[code], distanceExtra[code]);
+}
+
+static int matchLength(uint8_t *data, size_t position, size_t length, size_t distance)
+{
+    if(distance == 0 || distance > position || distance > MAX_DISTANCE)
+        return 0;
+    size_t limit = length - position < MAX_MATCH ? length - position : MAX_MATCH;
+    size_t count = 0;
+    while(count < limit && data[position + count] == data[position + count - distance])
+        count++;
+    return count;
+}
+
+// One final block with the fixed Huffman code. The only matches are runs of
+// the previous byte and repeats of the row above, which covers the empty 
+// space and the flat colors of sprite sheets without a hash chain. Returns
+// the length written to target, which needs room for 9 bits per byte.
+static size_t deflateFixed(uint8_t *target, uint8_t *raw, size_t rawSize, size_t stride)
+{
+    BitWriter writer = {.data = target};
+    putBits(&writer, 1, 1); // final block
+    putBits(&writer, 1, 2); // fixed Huffman code
+    size_t position = 0;
+    while(position < rawSize)
+    {
+        int run = matchLength(raw, position, rawSize, 1);
+        int above = matchLength(raw, position, rawSize, stride);
+        int length = run >= above ? run : above;
+        if(length >= MIN_MATCH)
+        {
+            putMatch(&writer, length, run >= above ? 1 : stride);
+            position += length;
+        }
+        else
+            putSymbol(&writer, raw[position++]);
+    }
+    putSymbol(&writer, 256); // end of block
+    putBits(&writer, 0, 7); // flush the last byte
+    return writer.length;
+}
+
+void png_writeIndexed(FILE *file, int width, int height, uint8_t *pixels,
+                      uint8_t palette[256][3])
+{
+    assert(file);
+    assert(width > 0 && height > 0);
+    if(!crcTable[1])
+        createCrcTable();
+    static const uint8_t signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    fwrite(signature, 1, sizeof (signature), file);
+
+    uint8_t header[13] = {0};
+    putUint32(header, width);
+    putUint32(header + 4, height);
+    header[8] = 8; // bit depth
+    header[9] = 3; // indexed color
+    writeChunk(file, "IHDR", header, sizeof (header));
+    writeChunk(file, "PLTE", palette[0], 256 * 3);
+    uint8_t transparency[1] = {0};
+    writeChunk(file, "tRNS", transparency, sizeof (transparency));
+
+    //Every row starts with filter type 0
+    size_t rawSize = (size_t)height * (width + 1);
+    uint8_t *raw = malloc(rawSize);
+    for(int y = 0; y < height; y++)
+    {
+        raw[y * (width + 1)] = 0;
+        memcpy(raw + y * (width + 1) + 1, pixels + (size_t)y * width, width);
+    }
+    uint8_t *data = malloc(2 + rawSize / 8 * 9 + 16 + 4);
+    data[0] = 0x78; // zlib header: deflate, 32K window
+    data[1] = 0x01;
+    size_t dataSize = 2 + deflateFixed(data + 2, raw, rawSize, width + 1);
+    putUint32(data + dataSize, adler32(1, raw, rawSize));
+    dataSize += 4;
+    assert(dataSize < UINT32_MAX);
+    writeChunk(file, "IDAT", data, dataSize);
+    writeChunk(file, "IEND", NULL, 0);
+    free(data);
+    free(raw);
+}
@@ -0,0 +1,14 @@
+#ifndef _PNG_H
+#define _PNG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Writes an 8 bit indexed PNG. The image data is compressed with the fixed 
+// Huffman code and only matches runs and the row above, which keeps the 
+// writer small and fast but doesn't reach zlib's ratio on busy images. 
+// Palette entry 0 is transparent.
+void png_writeIndexed(FILE *file, int width, int height, uint8_t *pixels,
+                      uint8_t palette[256][3]);
+
+#endif
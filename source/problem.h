@@ -1,8 +1,10 @@
 #ifndef PROBLEM_H
 #define PROBLEM_H
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef struct
@@ -10,8 +12,18 @@ typedef struct
     int score;
     int rawScore;
     int overlap;
+    int width; // of the bounding box
+    int height;
+    bool rejected; // score is only a lower bound that exceeded the cutoff
 }Score;
 
+typedef struct
+{
+    int bestScore;
+    int lowerBound;
+    uint64_t iterations;
+}RunResult;
+
 typedef struct Problem Problem;
 
 struct Problem
@@ -22,16 +34,47 @@ struct Problem
     int height;
     size_t chromosomSize;
     void (*initializeChromosom)(Problem *, void *);
-    Score (*calculateScore)(Problem *, void *);
+    // Evaluation may stop early once the score is known to exceed cutoff,
+    // INT_MAX disables this.
+    Score (*calculateScore)(Problem *, void *, int cutoff);
+    // Scores count chromosomes into scores, optional
+    void (*calculateScoreBatch)(Problem *, void **chromosomes, int count, 
+                                int cutoff, Score *scores);
     void (*crossover)(Problem *problem, void *mother, void *father, 
                                         void *child0, void *child1);
     void (*mutate)(Problem *problem, 
                    float mutationRate,
                    float muationDistance,
                    void *chromosom);
+    // Genotype distance in [0, 1] for diversity measures, optional
+    double (*distance)(Problem *problem, void *a, void *b);
+    // Small random change for local search, optional
+    void (*localMove)(Problem *problem, void *chromosom);
     void (*printChromosom)(Problem *problem, 
                            void *chromosomData, 
                            FILE *file);
+    // Image of the solution, optional
+    void (*writeImage)(Problem *problem, void *chromosomData, FILE *file);
+    // Fills chromosom with known layout number seed, false if there is none,
+    // optional
+    bool (*seedChromosom)(Problem *problem, int seed, void *chromosom);
+    // No valid solution can score below this, optional
+    int (*lowerBound)(Problem *problem);
+    // Copy with its own scratch memory for use on another thread, optional
+    Problem (*clone)(Problem *problem);
+    void (*freeClone)(Problem *clone);
 };
 
+// Prints the best score of a run, with the gap to the lower bound if known
+static inline void problem_printGap(Problem *problem, int best, int lowerBound)
+{
+    if(best == INT_MAX)
+        printf("%s: no valid solution\n", problem->name);
+    else if(lowerBound > 0)
+        printf("%s: best %i, lower bound %i, gap %.2f%%\n", problem->name, 
+               best, lowerBound, 100.0 * (best - lowerBound) / lowerBound);
+    else
+        printf("%s: best %i\n", problem->name, best);
+}
+
 #endif
@@ -0,0 +1,156 @@
+#include <string.h>
+#include <pthread.h>
+#include "profile.h"
+
+#ifdef PROFILE
+
+_Thread_local Profile profile_local;
+static Profile profile_merged;
+static Profile *profile_live; // profiles of the threads that are counting
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *phaseNames[PHASE_COUNT] =
+{
+    [PHASE_CALCULATE_POSITIONS] = "calculatePositions",
+    [PHASE_BLIT]                = "blit",
+    [PHASE_SCORE_SCAN]          = "scoreScan",
+    [PHASE_CROSSOVER]           = "crossover",
+    [PHASE_MUTATE]              = "mutate",
+    [PHASE_SELECTION]           = "selection",
+    [PHASE_TRACE_IO]            = "traceIO",
+};
+
+static char *counterNames[COUNTER_COUNT] =
+{
+    [COUNTER_FIT_TESTS]     = "fitTests",
+    [COUNTER_CELLS_TOUCHED] = "cellsTouched",
+    [COUNTER_RAY_STEPS]     = "raySteps",
+    [COUNTER_REUSED_PLACEMENTS] = "reusedPlacements",
+    [COUNTER_PLACEMENTS]    = "placements",
+    [COUNTER_EVALUATIONS]   = "evaluations",
+    [COUNTER_REJECTED]      = "rejected",
+    [COUNTER_RESTARTS]      = "restarts",
+};
+
+// Callers hold profile_mutex
+static void unlinkLocal(void)
+{
+    for(Profile **link = &profile_live; *link; link = &(*link)->next)
+    {
+        if(*link == &profile_local)
+        {
+            *link = profile_local.next;
+            break;
+        }
+    }
+}
+
+static void restartLocal(void)
+{
+    unlinkLocal();
+    memset(&profile_local, 0, sizeof(profile_local));
+    profile_local.start = profile_timestamp();
+    profile_local.next = profile_live;
+    profile_live = &profile_local;
+}
+
+// Merged profile plus the live ones. Their owners keep counting without the 
+// lock, so the sum is a snapshot that may be off by the updates in flight.
+// Callers hold profile_mutex.
+static Profile sumProfiles(void)
+{
+    Profile sum = profile_merged;
+    for(Profile *live = profile_live; live; live = live->next)
+    {
+        for(int i = 0; i < PHASE_COUNT; i++)
+        {
+            sum.ticks[i] += __atomic_load_n(&live->ticks[i], __ATOMIC_RELAXED);
+            sum.calls[i] += __atomic_load_n(&live->calls[i], __ATOMIC_RELAXED);
+        }
+        for(int i = 0; i < COUNTER_COUNT; i++)
+            sum.counters[i] += __atomic_load_n(&live->counters[i], __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+void profile_reset(void)
+{
+    pthread_mutex_lock(&profile_mutex);
+    memset(&profile_merged, 0, sizeof(profile_merged));
+    restartLocal();
+    pthread_mutex_unlock(&profile_mutex);
+}
+
+void profile_begin(void)
+{
+    pthread_mutex_lock(&profile_mutex);
+    restartLocal();
+    pthread_mutex_unlock(&profile_mutex);
+}
+
+void profile_merge(void)
+{
+    pthread_mutex_lock(&profile_mutex);
+    for(int i = 0; i < PHASE_COUNT; i++)
+    {
+        profile_merged.ticks[i] += profile_local.ticks[i];
+        profile_merged.calls[i] += profile_local.calls[i];
+    }
+    for(int i = 0; i < COUNTER_COUNT; i++)
+        profile_merged.counters[i] += profile_local.counters[i];
+    unlinkLocal();
+    pthread_mutex_unlock(&profile_mutex);
+    memset(&profile_local, 0, sizeof(profile_local));
+}
+
+void profile_printSummary(FILE *file, char *name)
+{
+    // Phases nest (blit runs inside calculatePositions), so the shares
+    // don't add up to 100%. Ticks of worker threads add up, so the shares
+    // can exceed 100% for parallel runs.
+    uint64_t total = profile_timestamp() - profile_local.start;
+    pthread_mutex_lock(&profile_mutex);
+    Profile profile = sumProfiles();
+    pthread_mutex_unlock(&profile_mutex);
+    fprintf(file, "%s profile: %lu ticks\n", name, total);
+    for(int i = 0; i < PHASE_COUNT; i++)
+    {
+        uint64_t calls = profile.calls[i];
+        fprintf(file, "  %-20s %14lu ticks %6.2f%% %10lu calls %12.1f ticks/call\n",
+                phaseNames[i], profile.ticks[i],
+                100.0 * profile.ticks[i] / (total ? total : 1),
+                calls, calls ? (double)profile.ticks[i] / calls : 0);
+    }
+    for(int i = 0; i < COUNTER_COUNT; i++)
+        fprintf(file, "  %-20s %14lu\n", counterNames[i], profile.counters[i]);
+    uint64_t placements = profile.counters[COUNTER_PLACEMENTS];
+    if(placements)
+        fprintf(file, "  %-20s %14.2f\n", "raySteps/placement",
+                (double)profile.counters[COUNTER_RAY_STEPS] / placements);
+}
+
+void profile_printSampleHeader(FILE *file)
+{
+    fprintf(file, "iteration");
+    for(int i = 0; i < PHASE_COUNT; i++)
+        fprintf(file, ",%s", phaseNames[i]);
+    for(int i = 0; i < COUNTER_COUNT; i++)
+        fprintf(file, ",%s", counterNames[i]);
+    fprintf(file, "\n");
+}
+
+// Totals of all threads so far, including the workers that are still running
+void profile_printSample(FILE *file, uint64_t iteration)
+{
+    pthread_mutex_lock(&profile_mutex);
+    Profile profile = sumProfiles();
+    pthread_mutex_unlock(&profile_mutex);
+    fprintf(file, "%lu", iteration);
+    for(int i = 0; i < PHASE_COUNT; i++)
+        fprintf(file, ", %lu", profile.ticks[i]);
+    for(int i = 0; i < COUNTER_COUNT; i++)
+        fprintf(file, ", %lu", profile.counters[i]);
+    fprintf(file, "\n");
+}
+
+#endif
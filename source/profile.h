@@ -0,0 +1,97 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Instrumentation for the hot paths, enabled with make PROFILE=1. Without
+// PROFILE the timer and counter macros expand to nothing and the functions
+// are empty stubs, so none of it costs anything.
+
+typedef enum
+{
+    PHASE_CALCULATE_POSITIONS,
+    PHASE_BLIT,
+    PHASE_SCORE_SCAN,
+    PHASE_CROSSOVER,
+    PHASE_MUTATE,
+    PHASE_SELECTION,
+    PHASE_TRACE_IO,
+    PHASE_COUNT
+}ProfilePhase;
+
+typedef enum
+{
+    COUNTER_FIT_TESTS,
+    COUNTER_CELLS_TOUCHED,
+    COUNTER_RAY_STEPS,
+    COUNTER_REUSED_PLACEMENTS,
+    COUNTER_PLACEMENTS,
+    COUNTER_EVALUATIONS,
+    COUNTER_REJECTED,
+    COUNTER_RESTARTS,
+    COUNTER_COUNT
+}ProfileCounter;
+
+#ifdef PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct Profile
+{
+    uint64_t start;
+    uint64_t ticks[PHASE_COUNT];
+    uint64_t calls[PHASE_COUNT];
+    uint64_t counters[COUNTER_COUNT];
+    struct Profile *next; // in the list of live profiles
+}Profile;
+
+// Every thread counts into its own profile. Worker threads list it with 
+// profile_begin, so samples and summaries include their running counts, and
+// add it to the merged profile with profile_merge before they exit.
+extern _Thread_local Profile profile_local;
+
+static inline uint64_t profile_timestamp(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000ull + time.tv_nsec;
+#endif
+}
+
+#define PROFILE_BEGIN(phase) uint64_t profileStart_##phase = profile_timestamp()
+#define PROFILE_END(phase) \
+    (profile_local.ticks[phase] += profile_timestamp() - profileStart_##phase, \
+     profile_local.calls[phase]++)
+#define PROFILE_COUNT(counter, amount) (profile_local.counters[counter] += (amount))
+
+void profile_reset(void);
+void profile_begin(void);
+void profile_merge(void);
+void profile_printSummary(FILE *file, char *name);
+void profile_printSampleHeader(FILE *file);
+void profile_printSample(FILE *file, uint64_t iteration);
+
+#else
+
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+#define PROFILE_COUNT(counter, amount)
+
+static inline void profile_reset(void) {}
+static inline void profile_begin(void) {}
+static inline void profile_merge(void) {}
+static inline void profile_printSummary(FILE *file, char *name) { (void)file; (void)name; }
+static inline void profile_printSampleHeader(FILE *file) { (void)file; }
+static inline void profile_printSample(FILE *file, uint64_t iteration) { (void)file; (void)iteration; }
+
+#endif
+
+#endif
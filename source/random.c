@@ -1,10 +1,16 @@
 #include <stdint.h>
+#include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 #include "problem.h"
+#include "profile.h"
 #include "random.h"
 
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
+// Chromosomes generated and scored together
+#define BATCH_SIZE 64
+
 typedef struct
 {
     void *chromosom;
@@ -16,19 +22,27 @@ typedef struct
 {
     Problem *problem;
     RandomSettings *settings;
-    Individual current;
+    Individual current[BATCH_SIZE];
+    void *batch[BATCH_SIZE];
+    Score scores[BATCH_SIZE];
     Individual best;
+    int lowerBound;
     uint64_t iteration;
 }Context;
 
-static void calculateAndPrintScore(Context *context, Individual *individual)
+static void printScore(Context *context, Individual *individual, Score score)
 {
-    Score score = context->problem->calculateScore(context->problem, individual->chromosom);
     individual->score = score.score;
+    PROFILE_BEGIN(PHASE_TRACE_IO);
     if(context->settings->scoreFile)
-        fprintf(context->settings->scoreFile, "%li, %i, %i, %i\n", 
-                context->iteration, score.score, score.rawScore, score.overlap);
-    if(score.overlap == 0 && context->best.score > score.score)
+        fprintf(context->settings->scoreFile, "%li, %i, %i, %i, %i\n", 
+                context->iteration, score.score, score.rawScore, score.overlap,
+                score.rejected);
+    if(context->settings->profileFile && 
+       context->iteration % context->settings->profileInterval == 0)
+        profile_printSample(context->settings->profileFile, context->iteration);
+    PROFILE_END(PHASE_TRACE_IO);
+    if(score.overlap == 0 && !score.rejected && context->best.score > score.score)
     {
         memcpy(context->best.chromosom, 
                individual->chromosom, 
@@ -38,33 +52,80 @@ static void calculateAndPrintScore(Context *context, Individual *individual)
     context->iteration++;
 }
 
+static void calculateAndPrintScores(Context *context, int count, int cutoff)
+{
+    Problem *problem = context->problem;
+    if(problem->calculateScoreBatch)
+    {
+        for(int i = 0; i < count; i++)
+            context->batch[i] = context->current[i].chromosom;
+        problem->calculateScoreBatch(problem, context->batch, count, cutoff, context->scores);
+    }
+    else
+    {
+        for(int i = 0; i < count; i++)
+            context->scores[i] = problem->calculateScore(problem, 
+                                                         context->current[i].chromosom,
+                                                         cutoff);
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(context->settings->stopAtLowerBound && 
+           context->best.score <= context->lowerBound)
+            break;
+        printScore(context, &context->current[i], context->scores[i]);
+    }
+}
+
 static void printCSVHeader(Context *context)
 {
     if(context->settings->scoreFile)
-        fprintf(context->settings->scoreFile, "iteration,score,rawScore,overlap\n");
+        fprintf(context->settings->scoreFile, "iteration,score,rawScore,overlap,rejected\n");
+    if(context->settings->profileFile)
+        profile_printSampleHeader(context->settings->profileFile);
 }
 
-void random_run(Problem *problem, RandomSettings *settings)
+RunResult random_run(Problem *problem, RandomSettings *settings)
 {
     Context context = 
     {
         .problem = problem,
         .settings = settings,
-        .current.chromosom = malloc(problem->chromosomSize),
         .best = 
         {
             .chromosom = malloc(problem->chromosomSize),
             .score = INT_MAX,
         }
     };
+    for(int i = 0; i < BATCH_SIZE; i++)
+        context.current[i].chromosom = malloc(problem->chromosomSize);
+    assert(!settings->profileFile || settings->profileInterval > 0);
+    profile_reset();
+    context.lowerBound = problem->lowerBound ? problem->lowerBound(problem) : 0;
     printCSVHeader(&context);
     while(context.iteration < settings->maxIteration)
     {
-        problem->initializeChromosom(problem, context.current.chromosom);
-        calculateAndPrintScore(&context, &context.current);
+        if(settings->stopAtLowerBound && context.best.score <= context.lowerBound)
+            break;
+        int count = MIN(BATCH_SIZE, settings->maxIteration - context.iteration);
+        for(int i = 0; i < count; i++)
+            problem->initializeChromosom(problem, context.current[i].chromosom);
+        //Only a new best matters, everything above it can be rejected early
+        int cutoff = settings->useScoreCutoff ? context.best.score : INT_MAX;
+        calculateAndPrintScores(&context, count, cutoff);
     }
     if(problem->printChromosom && settings->bestResultFile)
         problem->printChromosom(problem, context.best.chromosom, 
                                 settings->bestResultFile);
+    if(problem->writeImage && settings->bestImageFile)
+        problem->writeImage(problem, context.best.chromosom, settings->bestImageFile);
+    profile_printSummary(stdout, problem->name);
+    problem_printGap(problem, context.best.score, context.lowerBound);
+    return (RunResult)
+    {
+        .bestScore = context.best.score,
+        .lowerBound = context.lowerBound,
+        .iterations = context.iteration,
+    };
 }
 
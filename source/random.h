@@ -7,9 +7,14 @@ typedef struct
 {
     FILE *scoreFile;
     FILE *bestResultFile;
+    FILE *bestImageFile; // image of the best layout, needs problem->writeImage
+    FILE *profileFile; // periodic profile samples, needs PROFILE
+    uint64_t profileInterval;
     uint64_t maxIteration;
+    bool useScoreCutoff; // stop evaluating children that can't matter
+    bool stopAtLowerBound; // stop once the best reaches problem->lowerBound
 }RandomSettings;
 
-void random_run(Problem *problem, RandomSettings *settings);
+RunResult random_run(Problem *problem, RandomSettings *settings);
 
 #endif
@@ -1,6 +1,9 @@
 #include "vector2.h"
 #include "problem.h"
 #include "pcg_basic.h"
+#include "profile.h"
+#include "parallel.h"
+#include "png.h"
 #include <math.h>
 
 typedef struct
@@ -18,56 +21,205 @@ typedef enum
     MOV_CARTESIAN
 }PositionEncoding;
 
+typedef enum
+{
+    // CROSSOVER_POINT for the cartesian encodings, CROSSOVER_ORDER for 
+    // MOV_DIRECTION
+    CROSSOVER_DEFAULT,
+    // Single crossover point without reordering, cartesian encodings only
+    CROSSOVER_POINT,
+    // Every sprite from either parent. MOV_DIRECTION keeps the slots of one 
+    // parent and fills the rest in the order of the other.
+    CROSSOVER_UNIFORM,
+    // Sprites whose center lies in a random rectangle (and on a random page)
+    // come from one parent, cartesian encodings only
+    CROSSOVER_REGION,
+    // MOV_DIRECTION only: single segment order crossover, partially mapped
+    // crossover, cycle crossover and edge recombination. Sprites keep the
+    // direction gene of the parent their slot came from, with edge 
+    // recombination the parent whose edge led to the sprite.
+    CROSSOVER_ORDER,
+    CROSSOVER_PMX,
+    CROSSOVER_CYCLE,
+    CROSSOVER_EDGE
+}CrossoverOperator;
+
+// Horizontal run of set cells in a sprite row
+typedef struct
+{
+    int start;
+    int length;
+}Span;
+
 typedef struct
 {
     Vector2 dim;
     uint8_t *cells;
+    // Spans of row y are spans[rowSpans[y]] up to spans[rowSpans[y + 1]]
+    int *rowSpans;
+    Span *spans;
 }Sprite;
 
 typedef struct
 {
     PositionEncoding positionEncoding;
+    CrossoverOperator crossover;
     bool disableErrorTerm;
+    int threadCount; // for batch evaluation
+    int decodeCacheSize; // decoded layouts kept for prefix reuse, 0 disables
+    int decodeCacheInterval; // placements between grid snapshots
+    // Fixed size pages instead of one canvas: every sprite has a page gene
+    // and is placed on its own page grid. 0 disables.
+    Vector2 pageSize;
+    int pageCount; // pages the page gene can choose from
+    int padding; // empty cells between sprites
+    int extrusion; // cells every sprite is grown by on each side
+    int alignment; // positions are multiples of it, 0 or 1 disables
+    // Known layouts for spritePacking_seedChromosom: a shelf packing by
+    // decreasing height first if shelfSeed is set, then the best result CSVs
+    // of earlier runs in seedFiles.
+    bool shelfSeed;
+    char **seedFiles;
+    int seedFileCount;
 }SpritePackerSettings;
 
+// One step of the MOV_* decoders: the sprite and the direction of its ray,
+// quantized to [0, DIRECTION_STEPS].
+typedef struct
+{
+    int sprite;
+    int direction;
+}Placement;
+
+// Ray directions are quantized, so the Bresenham rise of every direction is
+// looked up per grid. MOV_CARTESIAN looks the direction of a position up by
+// its slope, quantized to SLOPE_STEPS.
+#define DIRECTION_STEPS 8192
+#define SLOPE_STEPS 8192
+
+// The grid is tracked in tiles of TILE_SIZE x TILE_SIZE cells. Only tiles 
+// that were written are cleared, scanned and copied.
+#define TILE_SIZE 64
+#define TILE_AREA (TILE_SIZE * TILE_SIZE)
+
+// Immutable copy of the dirty tiles of the grid, shared between traces.
+typedef struct
+{
+    int refCount;
+    int tileCount;
+    int *tiles;
+    uint8_t *cells; // TILE_AREA per tile
+}Snapshot;
+
+// A decoded layout: the placement sequence, where every sprite ended up and
+// the grid after every interval placements.
 typedef struct
+{
+    int length;
+    Placement *placements;
+    Vector2 *positions;
+    int snapshotCount;
+    Snapshot **snapshots;
+    uint64_t lastUse;
+}DecodeTrace;
+
+typedef struct
+{
+    int traceCount;
+    int interval;
+    uint64_t clock;
+    DecodeTrace *traces;
+}DecodeCache;
+
+// Position and page of every sprite
+typedef struct
+{
+    Vector2 *positions;
+    int *pages;
+}Layout;
+
+typedef struct SpritePacking SpritePacking;
+
+struct SpritePacking
 {
     SpritePackerSettings settings;
     int spriteCount;
+    Sprite *shapes; // as loaded
+    // Collision masks: the shapes grown by the extrusion and the padding, see
+    // prepareSprites. The same as shapes without either.
     Sprite *sprites;
     
     Vector2 bounds;
     int cellCount;
     uint8_t *cells;
-}SpritePacking;
+    int *rayRise; // DIRECTION_STEPS + 1, see allocateGrid
+    Vector2 tiles;
+    uint8_t *dirty; // per tile
+    int dirtyCount;
+    int *dirtyTiles;
+
+    // Decoder scratch and the prefix cache, created on first use
+    int *placementOrder;
+    int *crossoverScratch; // CROSSOVER_SCRATCH ints per sprite
+    uint8_t *sortScratch; // SORT_SCRATCH bytes per sprite
+    int *slopeDirections; // SLOPE_STEPS + 1, see createSlopeDirections
+    Placement *placements;
+    DecodeCache *decodeCache;
+
+    // Copies with their own scratch memory for batch evaluation on threads,
+    // created on first use.
+    int workerCount;
+    SpritePacking **workers;
+
+    // Page grids and the decoder steps grouped by page, created on first use
+    SpritePacking **pages;
+    int *pageSteps;
+    int *pageStart;
+
+    // Built from the settings by prepareSeeds
+    int seedCount;
+    Layout *seeds;
+};
 
 typedef struct
 {
     int index;
     Vector2 position;
     float direction; //[0, 1]
+    int page; // only used with settings.pageCount > 0
 }Chromosom;
 
-static bool containsIndex(Chromosom *chromosom, int segment[2], int index)
+#define CROSSOVER_SCRATCH 8
+// Two 64 bit distance keys and one index
+#define SORT_SCRATCH (2 * sizeof (uint64_t) + sizeof (int))
+
+// seen needs spriteCount ints
+static void testIndecies(Chromosom *chromosom, int spriteCount, int *seen)
 {
-    for(int i = segment[0]; i <= segment[1]; i++)
-        if(chromosom[i].index == index)
-            return true;
-    return false;
+    memset(seen, 0, spriteCount * sizeof (int));
+    for(int i = 0; i < spriteCount; i++)
+    {
+        assert(chromosom[i].index >= 0 && chromosom[i].index < spriteCount);
+        assert(!seen[chromosom[i].index]);
+        seen[chromosom[i].index] = 1;
+    }
 }
 
-static int findIndex(Chromosom *chromosom, int spriteCount, int index)
+static bool isPaged(SpritePacking *packer)
 {
-    for(int i = 0; i < spriteCount; i++)
-        if(chromosom[i].index == index)
-            return i;
-    return -1;
+    return packer->settings.pageCount > 0;
 }
 
-static void testIndecies(Chromosom *chromosom, int spriteCount)
+// Grid size that positions are drawn from. Page grids have one spare cell
+// and room for the padding of sprites at the right and bottom edge.
+static Vector2 positionBounds(SpritePacking *packer)
 {
-    for(int i = 0; i < spriteCount; i++)
-        assert(findIndex(chromosom, spriteCount, i) >= 0);
+    if(isPaged(packer))
+    {
+        int spare = packer->settings.padding + 1;
+        return vector2_add(packer->settings.pageSize, (Vector2){.x = spare, .y = spare});
+    }
+    return packer->bounds;
 }
 
 void spritePacking_initializeChromosom(Problem *problem, void *chromosomData)
@@ -76,7 +228,7 @@ void spritePacking_initializeChromosom(Problem *problem, void *chromosomData)
     Chromosom *chromosom = (Chromosom *)chromosomData;
     for(int spriteIndex = 0; spriteIndex < packer->spriteCount; spriteIndex++)
     {
-        Vector2 bounds = packer->bounds;
+        Vector2 bounds = positionBounds(packer);
         Vector2 spriteSize = packer->sprites[spriteIndex].dim;
         chromosom[spriteIndex] = (Chromosom)
         {
@@ -85,6 +237,8 @@ void spritePacking_initializeChromosom(Problem *problem, void *chromosomData)
             .position.y = pcg32_range(0, bounds.y - spriteSize.y),
             .direction = pcg32_fraction(),
         };
+        if(isPaged(packer))
+            chromosom[spriteIndex].page = pcg32_boundedrand(packer->settings.pageCount);
     }
     if(packer->settings.positionEncoding == MOV_DIRECTION)
     {
@@ -98,116 +252,367 @@ void spritePacking_initializeChromosom(Problem *problem, void *chromosomData)
     }
 }
 
+static void randomSegment(int segment[2], int spriteCount)
+{
+    int p0 = pcg32_boundedrand(spriteCount);
+    int p1 = pcg32_boundedrand(spriteCount);
+    segment[0] = MIN(p0, p1);
+    segment[1] = MAX(p0, p1);
+}
+
+// rank[sprite] is the slot of the sprite in chromosom
+static void rankSprites(Chromosom *chromosom, int spriteCount, int *rank)
+{
+    for(int i = 0; i < spriteCount; i++)
+        rank[chromosom[i].index] = i;
+}
+
+// The segment of the mother, the other slots in the order of the father.
+// taken needs spriteCount ints.
 static void orderCrossover(Chromosom *child, 
                            Chromosom *mother, 
                            Chromosom *father, 
                            int segment[2],
-                           int spriteCount)
+                           int spriteCount,
+                           int *taken)
 {
-    memcpy(&child[segment[0]], &mother[segment[0]], 
-            sizeof(Chromosom[segment[1] - segment[0] + 1]));
+    memset(taken, 0, spriteCount * sizeof (int));
+    for(int i = segment[0]; i <= segment[1]; i++)
+    {
+        child[i] = mother[i];
+        taken[mother[i].index] = 1;
+    }
     int fatherIndex = 0;
-    for(int childIndex = 0; childIndex < segment[0]; childIndex++)
+    for(int childIndex = 0; childIndex < spriteCount; childIndex++)
     {
-        while(containsIndex(child, segment, father[fatherIndex].index))
+        if(childIndex == segment[0])
+            childIndex = segment[1] + 1;
+        if(childIndex >= spriteCount)
+            break;
+        while(taken[father[fatherIndex].index])
             fatherIndex++;
         assert(fatherIndex < spriteCount);
         child[childIndex] = father[fatherIndex];
         fatherIndex++;
     }
-    for(int childIndex = segment[1] + 1; childIndex < spriteCount; childIndex++)
+}
+
+// The segment of the mother. The other slots keep the sprite of the father 
+// unless it is in the segment, then the sprite that it displaced there is 
+// followed until one outside of the segment turns up.
+static void pmxCrossover(Chromosom *child, 
+                         Chromosom *mother, 
+                         Chromosom *father, 
+                         int segment[2],
+                         int spriteCount,
+                         int *motherRank,
+                         int *taken)
+{
+    memset(taken, 0, spriteCount * sizeof (int));
+    for(int i = segment[0]; i <= segment[1]; i++)
+    {
+        child[i] = mother[i];
+        taken[mother[i].index] = 1;
+    }
+    for(int i = 0; i < spriteCount; i++)
+    {
+        if(i == segment[0])
+            i = segment[1] + 1;
+        if(i >= spriteCount)
+            break;
+        Chromosom gene = father[i];
+        while(taken[gene.index])
+            gene = father[motherRank[gene.index]];
+        child[i] = gene;
+    }
+}
+
+// Slots form cycles through the positions of the sprites in both parents.
+// Alternating cycles come from the mother and the father.
+static void cycleCrossover(Chromosom *child0, 
+                           Chromosom *child1, 
+                           Chromosom *mother, 
+                           Chromosom *father, 
+                           int spriteCount,
+                           int *motherRank,
+                           int *visited)
+{
+    memset(visited, 0, spriteCount * sizeof (int));
+    int cycle = 0;
+    for(int start = 0; start < spriteCount; start++)
+    {
+        if(visited[start])
+            continue;
+        int i = start;
+        do
+        {
+            visited[i] = 1;
+            child0[i] = cycle % 2 ? father[i] : mother[i];
+            child1[i] = cycle % 2 ? mother[i] : father[i];
+            i = motherRank[father[i].index];
+        }while(i != start);
+        cycle++;
+    }
+}
+
+// Neighbour entries hold the sprite shifted left by two and a bit for each 
+// parent that has the edge, EDGE_MOTHER and EDGE_FATHER
+#define EDGE_MOTHER 1
+#define EDGE_FATHER 2
+
+static void addEdge(int *neighbors, int *neighborCount, int from, int to, int parent)
+{
+    for(int i = 0; i < neighborCount[from]; i++)
+    {
+        if(neighbors[from * 4 + i] >> 2 == to)
+        {
+            neighbors[from * 4 + i] |= parent;
+            return;
+        }
+    }
+    neighbors[from * 4 + neighborCount[from]++] = to << 2 | parent;
+}
+
+static void removeEdge(int *neighbors, int *neighborCount, int from, int to)
+{
+    for(int i = 0; i < neighborCount[from]; i++)
+    {
+        if(neighbors[from * 4 + i] >> 2 == to)
+        {
+            neighbors[from * 4 + i] = neighbors[from * 4 + --neighborCount[from]];
+            return;
+        }
+    }
+}
+
+// Edge recombination: starts with the first sprite of first and continues 
+// with the neighbour in either parent order that has the fewest unvisited 
+// neighbours left, ties and dead ends are broken at random. Every sprite has 
+// at most four neighbours, so every step is constant time. A sprite takes its
+// gene from the parent whose edge led to it, from either one if both have the
+// edge or after a dead end. The first sprite keeps its gene from first. 
+// scratch needs 8 ints per sprite.
+static void edgeCrossover(Chromosom *child, 
+                          Chromosom *first, 
+                          Chromosom *mother, 
+                          Chromosom *father, 
+                          int spriteCount,
+                          int *scratch)
+{
+    int *neighbors = scratch;
+    int *neighborCount = neighbors + 4 * spriteCount;
+    int *unvisited = neighborCount + spriteCount;
+    int *rank = unvisited + spriteCount;
+    int *parents = rank + spriteCount;
+    memset(neighborCount, 0, spriteCount * sizeof (int));
+    for(int i = 0; i + 1 < spriteCount; i++)
+    {
+        addEdge(neighbors, neighborCount, mother[i].index, mother[i + 1].index, EDGE_MOTHER);
+        addEdge(neighbors, neighborCount, mother[i + 1].index, mother[i].index, EDGE_MOTHER);
+        addEdge(neighbors, neighborCount, father[i].index, father[i + 1].index, EDGE_FATHER);
+        addEdge(neighbors, neighborCount, father[i + 1].index, father[i].index, EDGE_FATHER);
+    }
+    // unvisited[rank[sprite]] == sprite for the unvisited sprites
+    for(int i = 0; i < spriteCount; i++)
+    {
+        unvisited[i] = i;
+        rank[i] = i;
+    }
+    int unvisitedCount = spriteCount;
+    int current = first[0].index;
+    int parent = first == mother ? EDGE_MOTHER : EDGE_FATHER;
+    for(int i = 0; i < spriteCount; i++)
+    {
+        child[i].index = current;
+        parents[i] = parent;
+        int last = unvisited[--unvisitedCount];
+        unvisited[rank[current]] = last;
+        rank[last] = rank[current];
+        for(int j = 0; j < neighborCount[current]; j++)
+            removeEdge(neighbors, neighborCount, neighbors[current * 4 + j] >> 2, current);
+        int next = -1;
+        int fewest = INT_MAX;
+        int ties = 0;
+        for(int j = 0; j < neighborCount[current]; j++)
+        {
+            int neighbor = neighbors[current * 4 + j] >> 2;
+            if(neighborCount[neighbor] < fewest)
+            {
+                fewest = neighborCount[neighbor];
+                next = neighbor;
+                parent = neighbors[current * 4 + j] & 3;
+                ties = 1;
+            }
+            else if(neighborCount[neighbor] == fewest && pcg32_boundedrand(++ties) == 0)
+            {
+                next = neighbor;
+                parent = neighbors[current * 4 + j] & 3;
+            }
+        }
+        if(next < 0 && unvisitedCount > 0)
+        {
+            next = unvisited[pcg32_boundedrand(unvisitedCount)];
+            parent = EDGE_MOTHER | EDGE_FATHER;
+        }
+        if(parent == (EDGE_MOTHER | EDGE_FATHER))
+            parent = pcg32_boundedrand(2) ? EDGE_MOTHER : EDGE_FATHER;
+        current = next;
+    }
+    // The genes of the sprites, rank and unvisited are free again
+    int *motherRank = rank;
+    int *fatherRank = unvisited;
+    rankSprites(mother, spriteCount, motherRank);
+    rankSprites(father, spriteCount, fatherRank);
+    for(int i = 0; i < spriteCount; i++)
+    {
+        int sprite = child[i].index;
+        child[i] = parents[i] == EDGE_MOTHER ? mother[motherRank[sprite]] : 
+                                               father[fatherRank[sprite]];
+    }
+}
+
+// The mother keeps the masked slots, the others get the sprites that are 
+// left in the order of the father. taken needs spriteCount ints.
+static void uniformOrderCrossover(Chromosom *child, 
+                                  Chromosom *mother, 
+                                  Chromosom *father, 
+                                  uint32_t *mask,
+                                  int spriteCount,
+                                  int *taken)
+{
+    memset(taken, 0, spriteCount * sizeof (int));
+    for(int i = 0; i < spriteCount; i++)
+    {
+        if(mask[i / 32] & (1u << i % 32))
+        {
+            child[i] = mother[i];
+            taken[mother[i].index] = 1;
+        }
+    }
+    int fatherIndex = 0;
+    for(int i = 0; i < spriteCount; i++)
     {
-        while(containsIndex(child, segment, father[fatherIndex].index))
+        if(mask[i / 32] & (1u << i % 32))
+            continue;
+        while(taken[father[fatherIndex].index])
             fatherIndex++;
-        assert(fatherIndex < spriteCount);
-        child[childIndex] = father[fatherIndex];
-        fatherIndex++;
+        child[i] = father[fatherIndex++];
     }
-    testIndecies(child, spriteCount);
 }
 
-void spritePacking_crossover(Problem *problem, 
-               void *motherData, void *fatherData, 
-               void *child0Data, void *child1Data)
+static bool inRegion(Sprite *sprites, Chromosom *gene, Vector2 min, Vector2 max, 
+                     bool paged, int page)
+{
+    Vector2 dim = sprites[gene->index].dim;
+    int x = gene->position.x + dim.x / 2;
+    int y = gene->position.y + dim.y / 2;
+    return x >= min.x && x <= max.x && y >= min.y && y <= max.y && 
+           (!paged || gene->page == page);
+}
+
+static CrossoverOperator crossoverOperator(SpritePacking *packer)
+{
+    CrossoverOperator operator = packer->settings.crossover;
+    bool permutation = packer->settings.positionEncoding == MOV_DIRECTION;
+    if(operator == CROSSOVER_DEFAULT)
+        return permutation ? CROSSOVER_ORDER : CROSSOVER_POINT;
+    bool spatial = operator == CROSSOVER_POINT || operator == CROSSOVER_REGION;
+    assert(operator == CROSSOVER_UNIFORM || permutation != spatial);
+    return operator;
+}
+
+// Mean gene distance in [0, 1]. With MOV_DIRECTION every sprite compares its
+// rank in the placement order and its direction, so a shifted order stays 
+// close. The cartesian encodings never reorder, their positions count 
+// relative to the position bounds. A different page counts half.
+double spritePacking_distance(Problem *problem, void *aData, void *bData)
 {
     SpritePacking *packer = (SpritePacking *)problem->data;
-    Chromosom *mother = (Chromosom *)motherData;
-    Chromosom *father = (Chromosom *)fatherData;
-    Chromosom *child0 = (Chromosom *)child0Data;
-    Chromosom *child1 = (Chromosom *)child1Data;
-
-    if(packer->settings.positionEncoding == POS_CARTESIAN ||
-       packer->settings.positionEncoding == MOV_CARTESIAN) 
-    {   
-        //Single crossover point without reordering 
-        int crossover = pcg32_boundedrand(packer->spriteCount);
-        memcpy(child0, mother, sizeof(Chromosom[crossover]));
-        memcpy(&child0[crossover], &father[crossover], 
-                sizeof(Chromosom[packer->spriteCount - crossover]));
-        memcpy(child1, father, sizeof(Chromosom[crossover]));
-        memcpy(&child1[crossover], &mother[crossover], 
-                sizeof(Chromosom[packer->spriteCount - crossover]));
-    }
-    else if(packer->settings.positionEncoding == MOV_DIRECTION)
-    {
-        //Single segment order crossover
-        int p0 = pcg32_boundedrand(packer->spriteCount);
-        int p1 = pcg32_boundedrand(packer->spriteCount);
-        int segment[2] = 
-        {
-            MIN(p0, p1),
-            MAX(p0, p1),
-        };
-        orderCrossover(child0, mother, father, segment, packer->spriteCount);
-        orderCrossover(child1, father, mother, segment, packer->spriteCount);
+    Chromosom *a = (Chromosom *)aData;
+    Chromosom *b = (Chromosom *)bData;
+    int spriteCount = packer->spriteCount;
+    Vector2 bounds = positionBounds(packer);
+    int rank[spriteCount];
+    for(int i = 0; i < spriteCount; i++)
+        rank[b[i].index] = i;
+    double sum = 0;
+    for(int i = 0; i < spriteCount; i++)
+    {
+        Chromosom *other = &b[rank[a[i].index]];
+        double distance;
+        if(packer->settings.positionEncoding == MOV_DIRECTION)
+            distance = (abs(i - rank[a[i].index]) / (double)MAX(spriteCount - 1, 1) +
+                        fabsf(a[i].direction - other->direction)) / 2;
+        else
+            distance = (abs(a[i].position.x - other->position.x) / (double)bounds.x +
+                        abs(a[i].position.y - other->position.y) / (double)bounds.y) / 2;
+        if(isPaged(packer))
+            distance = (distance + (a[i].page != other->page)) / 2;
+        sum += distance;
+    }
+    return sum / spriteCount;
+}
+
+static void clampPosition(SpritePacking *packer, Chromosom *gene)
+{
+    Vector2 spriteSize = packer->sprites[gene->index].dim;
+    for(int dimension = 0; dimension < 2; dimension++)
+    {
+        int *value = &gene->position.i[dimension];
+        *value = CLAMP(*value, 0, positionBounds(packer).i[dimension] - 
+                                  spriteSize.i[dimension] - 1);
     }
-    else
-        assert(false);
 }
 
-void spritePacking_mutate(Problem *problem, 
-                          float mutationRate, 
-                          float mutationDistance, 
-                          void *chromosomData)
+// Local search moves: swap two sprites, nudge a sprite towards the origin or
+// tweak its direction. Only the moves that change the decoded layout of the 
+// current encoding are used. With pages a sprite can also move to another page.
+void spritePacking_localMove(Problem *problem, void *chromosomData)
 {
     SpritePacking *packer = (SpritePacking *)problem->data;
     Chromosom *chromosom = (Chromosom *)chromosomData;
-    for(int spriteIndex = 0; spriteIndex < packer->spriteCount; spriteIndex++)
+    PositionEncoding encoding = packer->settings.positionEncoding;
+    Chromosom *gene = &chromosom[pcg32_boundedrand(packer->spriteCount)];
+    int move = pcg32_boundedrand(isPaged(packer) ? 4 : 3);
+    if(move == 3)
+        gene->page = pcg32_boundedrand(packer->settings.pageCount);
+    else if(move == 0)
     {
-        for(int dimension = 0; dimension < 2; dimension++)
+        Chromosom *other = &chromosom[pcg32_boundedrand(packer->spriteCount)];
+        if(encoding == MOV_DIRECTION)
         {
-            if(pcg32_fraction() <= mutationRate)
-            {
-                if(packer->settings.positionEncoding == POS_CARTESIAN ||
-                   packer->settings.positionEncoding == MOV_CARTESIAN)
-                {
-                    int bounds = packer->bounds.i[dimension];
-                    int maxDistance = bounds * mutationDistance;
-                    int change =  pcg32_range(-maxDistance, maxDistance + 1);
-                    int *value = &chromosom[spriteIndex].position.i[dimension];
-                    int newValue = *value + change;
-                    int spriteSize = packer->sprites[spriteIndex].dim.i[dimension];
-                    *value = CLAMP(newValue, 0, bounds - spriteSize - 1);
-                }
-                else if(packer->settings.positionEncoding == MOV_DIRECTION)
-                {
-                    if(dimension == 0)
-                    {
-                        float change = (pcg32_fraction() - 0.5) * 2 * mutationDistance;
-                        float *value = &chromosom[spriteIndex].direction;
-                        *value = CLAMP(*value + change, 0, 1);
-                    }
-                    else
-                    {
-                        int p0 = pcg32_boundedrand(packer->spriteCount);
-                        int p1 = pcg32_boundedrand(packer->spriteCount);
-                        Chromosom tmp = chromosom[p0];
-                        chromosom[p0] = chromosom[p1];
-                        chromosom[p1] = tmp;
-                    }
-                }
-            }
+            float tmp = gene->direction;
+            gene->direction = other->direction;
+            other->direction = tmp;
         }
+        else
+        {
+            Vector2 tmp = gene->position;
+            gene->position = other->position;
+            other->position = tmp;
+            clampPosition(packer, gene);
+            clampPosition(packer, other);
+        }
+    }
+    else if(encoding == MOV_DIRECTION)
+    {
+        float change = (pcg32_fraction() - 0.5) * 0.1;
+        gene->direction = CLAMP(gene->direction + change, 0, 1);
+    }
+    else if(move == 1 || encoding == POS_CARTESIAN)
+    {
+        int dimension = pcg32_boundedrand(2);
+        int maxDistance = MAX(positionBounds(packer).i[dimension] / 50, 1);
+        gene->position.i[dimension] -= pcg32_range(1, maxDistance + 1);
+        clampPosition(packer, gene);
+    }
+    else
+    {
+        //Rotate around the origin, which changes the MOV_CARTESIAN direction
+        int step = pcg32_boundedrand(2) ? 1 : -1;
+        gene->position.x += step;
+        gene->position.y -= step;
+        clampPosition(packer, gene);
     }
 }
 
@@ -225,204 +630,1157 @@ Sprite shape_allocate(int width, int height)
     return result;
 }
 
-bool doesSpriteFit(SpritePacking *packer, Sprite sprite, int xOffset, int yOffset)
+// Replaces the grid by an empty one of the given size
+static void allocateGrid(SpritePacking *packer, Vector2 bounds)
+{
+    free(packer->cells);
+    free(packer->rayRise);
+    free(packer->dirty);
+    free(packer->dirtyTiles);
+    packer->bounds = bounds;
+    packer->cellCount = bounds.x * bounds.y;
+    packer->tiles.x = (bounds.x + TILE_SIZE - 1) / TILE_SIZE;
+    packer->tiles.y = (bounds.y + TILE_SIZE - 1) / TILE_SIZE;
+    packer->cells = calloc(packer->cellCount, sizeof (packer->cells[0]));
+    packer->dirty = calloc(packer->tiles.x * packer->tiles.y, sizeof (packer->dirty[0]));
+    packer->dirtyCount = 0;
+    packer->dirtyTiles = malloc(packer->tiles.x * packer->tiles.y * sizeof (int));
+    // Rays below the diagonal step along x and rise up to twice the height,
+    // the others step along y
+    packer->rayRise = malloc((DIRECTION_STEPS + 1) * sizeof (int));
+    for(int i = 0; i <= DIRECTION_STEPS; i++)
+        packer->rayRise[i] = i < DIRECTION_STEPS / 2 ?
+            2 * i * bounds.y / DIRECTION_STEPS : 2 * (DIRECTION_STEPS - i) * bounds.x / DIRECTION_STEPS;
+}
+
+// Direction of the slopes in [0, 1], as a fraction of the quarter circle
+static int *createSlopeDirections(void)
+{
+    int *result = malloc((SLOPE_STEPS + 1) * sizeof (int));
+    for(int i = 0; i <= SLOPE_STEPS; i++)
+        result[i] = lround(atan((double)i / SLOPE_STEPS) / (M_PI / 2) * DIRECTION_STEPS);
+    return result;
+}
+
+// The canvas holds all sprites side by side in both directions
+static Vector2 canvasBounds(Sprite *sprites, int spriteCount)
+{
+    Vector2 result = {0};
+    for(int i = 0; i < spriteCount; i++)
+        result = vector2_add(result, sprites[i].dim);
+    return result;
+}
+
+static void markDirty(SpritePacking *packer, int x, int y, int width, int height)
+{
+    for(int tileY = y / TILE_SIZE; tileY <= (y + height - 1) / TILE_SIZE; tileY++)
+    {
+        for(int tileX = x / TILE_SIZE; tileX <= (x + width - 1) / TILE_SIZE; tileX++)
+        {
+            int tile = tileX + tileY * packer->tiles.x;
+            if(!packer->dirty[tile])
+            {
+                packer->dirty[tile] = 1;
+                packer->dirtyTiles[packer->dirtyCount++] = tile;
+            }
+        }
+    }
+}
+
+// Position and size of a tile, tiles at the right and bottom edge are cut off
+static void tileRect(SpritePacking *packer, int tile, Vector2 *origin, Vector2 *size)
+{
+    origin->x = tile % packer->tiles.x * TILE_SIZE;
+    origin->y = tile / packer->tiles.x * TILE_SIZE;
+    size->x = MIN(TILE_SIZE, packer->bounds.x - origin->x);
+    size->y = MIN(TILE_SIZE, packer->bounds.y - origin->y);
+}
+
+static void clearCells(SpritePacking *packer)
+{
+    for(int i = 0; i < packer->dirtyCount; i++)
+    {
+        int tile = packer->dirtyTiles[i];
+        Vector2 origin, size;
+        tileRect(packer, tile, &origin, &size);
+        uint8_t *line = packer->cells + origin.x + origin.y * packer->bounds.x;
+        for(int y = 0; y < size.y; y++)
+        {
+            memset(line, 0, size.x);
+            line += packer->bounds.x;
+        }
+        packer->dirty[tile] = 0;
+    }
+    packer->dirtyCount = 0;
+}
+
+void shape_compileSpans(Sprite *sprite)
+{
+    int spanCount = 0;
+    for(int i = 0; i < sprite->dim.x * sprite->dim.y; i++)
+        if(sprite->cells[i] && (i % sprite->dim.x == 0 || !sprite->cells[i - 1]))
+            spanCount++;
+    sprite->rowSpans = malloc((sprite->dim.y + 1) * sizeof (int));
+    sprite->spans = malloc(spanCount * sizeof (Span));
+    spanCount = 0;
+    for(int y = 0; y < sprite->dim.y; y++)
+    {
+        sprite->rowSpans[y] = spanCount;
+        uint8_t *row = sprite->cells + y * sprite->dim.x;
+        for(int x = 0; x < sprite->dim.x; x++)
+        {
+            if(!row[x])
+                continue;
+            Span *span = &sprite->spans[spanCount++];
+            span->start = x;
+            while(x < sprite->dim.x && row[x])
+                x++;
+            span->length = x - span->start;
+        }
+    }
+    sprite->rowSpans[sprite->dim.y] = spanCount;
+}
+
+void shape_free(Sprite sprite)
+{
+    free(sprite.cells);
+    free(sprite.rowSpans);
+    free(sprite.spans);
+}
+
+// Minkowski sum with the square [-before, after]^2, one pass per axis. The 
+// result starts before cells left of and above the shape.
+Sprite shape_dilate(Sprite shape, int before, int after)
+{
+    int grow = before + after;
+    Sprite rows = shape_allocate(shape.dim.x + grow, shape.dim.y);
+    for(int y = 0; y < shape.dim.y; y++)
+        for(int x = 0; x < shape.dim.x; x++)
+            if(shape.cells[x + y * shape.dim.x])
+                memset(rows.cells + x + y * rows.dim.x, 1, grow + 1);
+    Sprite result = shape_allocate(shape.dim.x + grow, shape.dim.y + grow);
+    for(int y = 0; y < rows.dim.y; y++)
+        for(int x = 0; x < rows.dim.x; x++)
+            if(rows.cells[x + y * rows.dim.x])
+                for(int i = 0; i <= grow; i++)
+                    result.cells[x + (y + i) * result.dim.x] = 1;
+    free(rows.cells);
+    shape_compileSpans(&result);
+    return result;
+}
+
+// Index of the first set cell or -1
+static int firstSet(uint8_t *cells, int length)
+{
+    int i = 0;
+    for(; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, cells + i, sizeof (word));
+        if(word)
+            break;
+    }
+    for(; i < length; i++)
+        if(cells[i])
+            return i;
+    return -1;
+}
+
+// Returns false if the sprite collides at the offset and reports the first
+// colliding grid cell and the sprite span it was found in.
+static bool findCollision(SpritePacking *packer, Sprite sprite, int xOffset, int yOffset,
+                          Vector2 *cell, Span *collidingSpan)
 {
     assert(xOffset >= 0);
     assert(yOffset >= 0);
     assert(xOffset + sprite.dim.x < packer->bounds.x);
     assert(yOffset + sprite.dim.y < packer->bounds.y);
+    PROFILE_COUNT(COUNTER_FIT_TESTS, 1);
 
     uint8_t *targetLine = packer->cells + (xOffset + yOffset * packer->bounds.x);
-    uint8_t *sourceCell = sprite.cells;
     for(int y = 0; y < sprite.dim.y; y++)
     {
-        uint8_t *targetCell = targetLine;
-        for(int x = 0; x < sprite.dim.x; x++)
+        for(int i = sprite.rowSpans[y]; i < sprite.rowSpans[y + 1]; i++)
         {
-            if(*targetCell && *sourceCell)
+            Span span = sprite.spans[i];
+            PROFILE_COUNT(COUNTER_CELLS_TOUCHED, span.length);
+            int hit = firstSet(targetLine + span.start, span.length);
+            if(hit >= 0)
+            {
+                cell->x = xOffset + span.start + hit;
+                cell->y = yOffset + y;
+                *collidingSpan = span;
                 return false;
-            targetCell++;
-            sourceCell++;
+            }
         }
         targetLine += packer->bounds.x;
     }
     return true;
 }
 
+bool doesSpriteFit(SpritePacking *packer, Sprite sprite, int xOffset, int yOffset)
+{
+    Vector2 cell;
+    Span span;
+    return findCollision(packer, sprite, xOffset, yOffset, &cell, &span);
+}
+
+// Last cell of the run of set cells that starts at cell, walking along x or y
+static int occupiedRunEnd(SpritePacking *packer, Vector2 cell, bool alongX)
+{
+    int stride = alongX ? 1 : packer->bounds.x;
+    int end = alongX ? packer->bounds.x : packer->bounds.y;
+    int position = alongX ? cell.x : cell.y;
+    uint8_t *target = packer->cells + cell.x + cell.y * packer->bounds.x;
+    while(position + 1 < end && target[stride])
+    {
+        target += stride;
+        position++;
+    }
+    return position;
+}
+
 void blitSprite(SpritePacking *packer, Sprite sprite, int xOffset, int yOffset)
 {
     assert(xOffset >= 0);
     assert(yOffset >= 0);
     assert(xOffset + sprite.dim.x < packer->bounds.x);
     assert(yOffset + sprite.dim.y < packer->bounds.y);
+    PROFILE_BEGIN(PHASE_BLIT);
+    markDirty(packer, xOffset, yOffset, sprite.dim.x, sprite.dim.y);
 
     uint8_t *targetLine = packer->cells + (xOffset + yOffset * packer->bounds.x);
-    uint8_t *sourceCell = sprite.cells;
+    uint8_t *sourceLine = sprite.cells;
     for(int y = 0; y < sprite.dim.y; y++)
     {
-        uint8_t *targetCell = targetLine;
-        for(int x = 0; x < sprite.dim.x; x++)
+        for(int i = sprite.rowSpans[y]; i < sprite.rowSpans[y + 1]; i++)
         {
-            *targetCell += *sourceCell;
-            targetCell++;
-            sourceCell++;
+            Span span = sprite.spans[i];
+            PROFILE_COUNT(COUNTER_CELLS_TOUCHED, span.length);
+            for(int x = span.start; x < span.start + span.length; x++)
+                targetLine[x] += sourceLine[x];
         }
         targetLine += packer->bounds.x;
+        sourceLine += sprite.dim.x;
     }
+    PROFILE_END(PHASE_BLIT);
 }
 
-static int chromosom_distance(const void *a, const void *b)
+// Snaps POS_CARTESIAN positions down to the alignment
+static void alignPosition(SpritePacking *packer, Chromosom *gene)
 {
-    Vector2 pA = ((Chromosom *)a)->position;
-    Vector2 pB = ((Chromosom *)b)->position;
-    float distA = pA.x * pA.x + pA.y * pA.y;
-    float distB = pB.x * pB.x + pB.y * pB.y;
-    return distA - distB;
+    int alignment = packer->settings.alignment;
+    if(alignment > 1)
+    {
+        gene->position.x -= gene->position.x % alignment;
+        gene->position.y -= gene->position.y % alignment;
+    }
 }
 
-static int chromosom_index(const void *a, const void *b)
+static int alignUp(int value, int alignment)
 {
-    Chromosom *chromosomA = (Chromosom *)a;
-    Chromosom *chromosomB = (Chromosom *)b;
-    return chromosomA->index - chromosomB->index;
+    if(alignment <= 1)
+        return value;
+    return (value + alignment - 1) / alignment * alignment;
 }
 
-static void calculatePositions(SpritePacking *packer, Chromosom *chromosom)
+static DecodeCache *decodeCache_create(int spriteCount, int traceCount, int interval)
 {
-    if(packer->settings.positionEncoding == MOV_CARTESIAN)
-        qsort(chromosom, packer->spriteCount, sizeof(Chromosom), chromosom_distance);
-    memset(packer->cells, 0, packer->cellCount);
-    for(int i = 0; i < packer->spriteCount; i++)
+    assert(interval > 0);
+    DecodeCache *cache = malloc(sizeof (DecodeCache));
+    *cache = (DecodeCache)
+    {
+        .traceCount = traceCount,
+        .interval = interval,
+        .traces = calloc(traceCount, sizeof (DecodeTrace)),
+    };
+    for(int i = 0; i < traceCount; i++)
+    {
+        DecodeTrace *trace = &cache->traces[i];
+        trace->placements = malloc(spriteCount * sizeof (Placement));
+        trace->positions = malloc(spriteCount * sizeof (Vector2));
+        trace->snapshots = calloc(spriteCount / interval + 1, sizeof (Snapshot *));
+    }
+    return cache;
+}
+
+static void snapshot_release(Snapshot *snapshot)
+{
+    if(--snapshot->refCount == 0)
+        free(snapshot);
+}
+
+static void decodeCache_free(DecodeCache *cache)
+{
+    if(!cache)
+        return;
+    for(int i = 0; i < cache->traceCount; i++)
     {
-        int index;
-        float direction;
-        if(packer->settings.positionEncoding == MOV_CARTESIAN)
+        DecodeTrace *trace = &cache->traces[i];
+        for(int k = 0; k < trace->snapshotCount; k++)
+            snapshot_release(trace->snapshots[k]);
+        free(trace->placements);
+        free(trace->positions);
+        free(trace->snapshots);
+    }
+    free(cache->traces);
+    free(cache);
+}
+
+// Trace sharing the longest prefix with the first count placements
+static DecodeTrace *decodeCache_findPrefix(DecodeCache *cache, Placement *placements,
+                                           int count, int *prefix)
+{
+    DecodeTrace *result = NULL;
+    *prefix = 0;
+    for(int i = 0; i < cache->traceCount; i++)
+    {
+        DecodeTrace *trace = &cache->traces[i];
+        int length = 0;
+        int limit = MIN(trace->length, count);
+        while(length < limit &&
+              trace->placements[length].sprite == placements[length].sprite &&
+              trace->placements[length].direction == placements[length].direction)
+            length++;
+        if(length > *prefix)
         {
-            index = i;
-            direction = atan2(chromosom[i].position.y, chromosom[i].position.x);
-            direction /= (M_PI / 2);
+            *prefix = length;
+            result = trace;
         }
-        else
+    }
+    return result;
+}
+
+// Least recently used trace other than keep
+static DecodeTrace *decodeCache_victim(DecodeCache *cache, DecodeTrace *keep)
+{
+    DecodeTrace *result = NULL;
+    for(int i = 0; i < cache->traceCount; i++)
+    {
+        DecodeTrace *trace = &cache->traces[i];
+        if(trace != keep && (!result || trace->lastUse < result->lastUse))
+            result = trace;
+    }
+    return result ? result : keep;
+}
+
+// Copies the tiles between the grid and a snapshot
+static void copyTiles(SpritePacking *packer, Snapshot *snapshot, bool restore)
+{
+    for(int i = 0; i < snapshot->tileCount; i++)
+    {
+        Vector2 origin, size;
+        tileRect(packer, snapshot->tiles[i], &origin, &size);
+        uint8_t *line = packer->cells + origin.x + origin.y * packer->bounds.x;
+        uint8_t *tileLine = snapshot->cells + i * TILE_AREA;
+        for(int y = 0; y < size.y; y++)
         {
-            index = findIndex(chromosom, packer->spriteCount, i);
-            assert(index >= 0);
-            direction = chromosom[index].direction;
+            if(restore)
+                memcpy(line, tileLine, size.x);
+            else
+                memcpy(tileLine, line, size.x);
+            line += packer->bounds.x;
+            tileLine += TILE_SIZE;
         }
-        assert(direction >= 0);
-        assert(direction <= 1);
-        Sprite sprite = packer->sprites[chromosom[index].index];
-        Vector2 bounds = vector2_sub(packer->bounds, sprite.dim);
-        bool horizontal = direction < 0.5;
-        int dx, dy, maxX;
-        if(horizontal)
+    }
+}
+
+// Restores the grid and the positions after the first prefix placements of 
+// source: copies the tiles of the deepest snapshot and blits the remaining 
+// sprites at their known positions, without walking their rays.
+static void restorePrefix(SpritePacking *packer, DecodeTrace *source, int prefix,
+                          Chromosom *chromosom)
+{
+    int interval = packer->decodeCache->interval;
+    int snapshotIndex = MIN(prefix / interval, source->snapshotCount) - 1;
+    int step = 0;
+    if(snapshotIndex >= 0)
+    {
+        Snapshot *snapshot = source->snapshots[snapshotIndex];
+        copyTiles(packer, snapshot, true);
+        for(int i = 0; i < snapshot->tileCount; i++)
         {
-            dx = packer->bounds.x;
-            maxX = bounds.x;
-            dy = direction * 2 * packer->bounds.y;
+            packer->dirty[snapshot->tiles[i]] = 1;
+            packer->dirtyTiles[packer->dirtyCount++] = snapshot->tiles[i];
         }
-        else
+        step = (snapshotIndex + 1) * interval;
+    }
+    for(int i = 0; i < prefix; i++)
+    {
+        Chromosom *gene = &chromosom[packer->placementOrder[i]];
+        gene->position = source->positions[i];
+        if(i >= step)
+            blitSprite(packer, packer->sprites[gene->index], 
+                       gene->position.x, gene->position.y);
+    }
+    PROFILE_COUNT(COUNTER_REUSED_PLACEMENTS, prefix);
+}
+
+static Snapshot *takeSnapshot(SpritePacking *packer)
+{
+    int tileCount = packer->dirtyCount;
+    Snapshot *snapshot = malloc(sizeof (Snapshot) + tileCount * (sizeof (int) + TILE_AREA));
+    *snapshot = (Snapshot)
+    {
+        .refCount = 1,
+        .tileCount = tileCount,
+        .tiles = (int *)(snapshot + 1),
+        .cells = (uint8_t *)((int *)(snapshot + 1) + tileCount),
+    };
+    memcpy(snapshot->tiles, packer->dirtyTiles, tileCount * sizeof (int));
+    copyTiles(packer, snapshot, false);
+    return snapshot;
+}
+
+// Stable LSD radix sort of the chromosom indices by squared distance from the
+// origin into order, one counting pass per byte of the largest key. The keys 
+// are 64 bit, so they can't overflow on any grid. Equal distances keep the 
+// chromosom order.
+static void sortByDistance(SpritePacking *packer, Chromosom *chromosom, int *order)
+{
+    int spriteCount = packer->spriteCount;
+    uint64_t *keys = (uint64_t *)packer->sortScratch;
+    uint64_t *swapKeys = keys + spriteCount;
+    int *swapOrder = (int *)(swapKeys + spriteCount);
+    int *result = order;
+    uint64_t maxKey = 0;
+    for(int i = 0; i < spriteCount; i++)
+    {
+        int64_t x = chromosom[i].position.x;
+        int64_t y = chromosom[i].position.y;
+        keys[i] = x * x + y * y;
+        order[i] = i;
+        maxKey = MAX(maxKey, keys[i]);
+    }
+    for(int shift = 0; shift < 64 && (maxKey >> shift) > 0; shift += 8)
+    {
+        int offsets[257] = {0};
+        for(int i = 0; i < spriteCount; i++)
+            offsets[(keys[i] >> shift & 255) + 1]++;
+        for(int digit = 0; digit < 256; digit++)
+            offsets[digit + 1] += offsets[digit];
+        for(int i = 0; i < spriteCount; i++)
         {
-            dx = packer->bounds.y;
-            maxX = bounds.y;
-            dy = (1 - direction) * 2 * packer->bounds.x;
+            int target = offsets[keys[i] >> shift & 255]++;
+            swapKeys[target] = keys[i];
+            swapOrder[target] = order[i];
         }
-        int y = 0;
-        int D = 2 * dy - dx;
-        for(int x = 0; x < dx; x++)
+        uint64_t *swapKey = keys;
+        keys = swapKeys;
+        swapKeys = swapKey;
+        int *swap = order;
+        order = swapOrder;
+        swapOrder = swap;
+    }
+    if(order != result)
+        memcpy(result, order, spriteCount * sizeof (int));
+}
+
+// Quantized direction of the ray from the origin through position, the
+// slope is taken against the larger coordinate so it stays in [0, 1]. The
+// products are 64 bit so large grids don't overflow.
+static int positionDirection(SpritePacking *packer, Vector2 position)
+{
+    int64_t x = position.x;
+    int64_t y = position.y;
+    if(y <= x)
+        return x == 0 ? 0 : packer->slopeDirections[(y * SLOPE_STEPS + x / 2) / x];
+    return DIRECTION_STEPS - packer->slopeDirections[(x * SLOPE_STEPS + y / 2) / y];
+}
+
+static SpritePacking *cloneWithBounds(SpritePacking *packer, Vector2 bounds);
+
+typedef struct
+{
+    SpritePacking *packer;
+    Chromosom *chromosom;
+    int *usedPages;
+    int *areas;
+    Vector2 *sizes;
+    int *overlaps;
+}PageBatch;
+
+static void ensurePages(SpritePacking *packer)
+{
+    if(packer->pages)
+        return;
+    Vector2 pageSize = packer->settings.pageSize;
+    for(int i = 0; i < packer->spriteCount; i++)
+        assert(packer->sprites[i].dim.x <= pageSize.x + packer->settings.padding && 
+               packer->sprites[i].dim.y <= pageSize.y + packer->settings.padding);
+    packer->pages = malloc(packer->settings.pageCount * sizeof (SpritePacking *));
+    for(int i = 0; i < packer->settings.pageCount; i++)
+        packer->pages[i] = cloneWithBounds(packer, positionBounds(packer));
+    packer->pageSteps = malloc(packer->spriteCount * sizeof (int));
+    packer->pageStart = malloc((packer->settings.pageCount + 1) * sizeof (int));
+}
+
+// Copy with its own grid of the given size and its own scratch memory
+static SpritePacking *cloneWithBounds(SpritePacking *packer, Vector2 bounds)
+{
+    SpritePacking *clone = malloc(sizeof (SpritePacking));
+    *clone = *packer;
+    clone->cells = NULL;
+    clone->rayRise = NULL;
+    clone->dirty = NULL;
+    clone->dirtyTiles = NULL;
+    allocateGrid(clone, bounds);
+    clone->placementOrder = malloc(packer->spriteCount * sizeof (int));
+    clone->crossoverScratch = malloc(packer->spriteCount * CROSSOVER_SCRATCH * sizeof (int));
+    clone->sortScratch = malloc(packer->spriteCount * SORT_SCRATCH);
+    clone->slopeDirections = malloc((SLOPE_STEPS + 1) * sizeof (int));
+    memcpy(clone->slopeDirections, packer->slopeDirections, (SLOPE_STEPS + 1) * sizeof (int));
+    clone->placements = malloc(packer->spriteCount * sizeof (Placement));
+    clone->decodeCache = NULL;
+    clone->workerCount = 0;
+    clone->workers = NULL;
+    clone->pages = NULL;
+    clone->pageSteps = NULL;
+    clone->pageStart = NULL;
+    return clone;
+}
+
+static SpritePacking *cloneData(SpritePacking *packer)
+{
+    return cloneWithBounds(packer, packer->bounds);
+}
+
+static void freeData(SpritePacking *packer);
+
+static void freePages(SpritePacking *packer)
+{
+    if(!packer->pages)
+        return;
+    for(int i = 0; i < packer->settings.pageCount; i++)
+        freeData(packer->pages[i]);
+    free(packer->pages);
+    free(packer->pageSteps);
+    free(packer->pageStart);
+    packer->pages = NULL;
+    packer->pageSteps = NULL;
+    packer->pageStart = NULL;
+}
+
+// Drops everything that depends on the settings
+static void resetScratch(SpritePacking *packer)
+{
+    decodeCache_free(packer->decodeCache);
+    packer->decodeCache = NULL;
+    freePages(packer);
+    for(int i = 0; i < packer->workerCount; i++)
+        freeData(packer->workers[i]);
+    free(packer->workers);
+    packer->workers = NULL;
+    packer->workerCount = 0;
+}
+
+// Rebuilds the collision masks from the shapes for the current settings: 
+// extrusion grows the shapes on every side, padding on the right and the
+// bottom. Two grown masks that don't overlap keep their shapes padding cells
+// apart, so the kernels need no extra tests. The canvas is resized to fit.
+static void prepareSprites(SpritePacking *packer)
+{
+    if(packer->sprites != packer->shapes)
+    {
+        for(int i = 0; i < packer->spriteCount; i++)
+            shape_free(packer->sprites[i]);
+        free(packer->sprites);
+    }
+    int before = packer->settings.extrusion;
+    int after = before + packer->settings.padding;
+    packer->sprites = packer->shapes;
+    if(after > 0)
+    {
+        packer->sprites = malloc(packer->spriteCount * sizeof (Sprite));
+        for(int i = 0; i < packer->spriteCount; i++)
+            packer->sprites[i] = shape_dilate(packer->shapes[i], before, after);
+    }
+    Vector2 bounds = canvasBounds(packer->sprites, packer->spriteCount);
+    if(bounds.x != packer->bounds.x || bounds.y != packer->bounds.y)
+        allocateGrid(packer, bounds);
+}
+
+static void freeData(SpritePacking *packer)
+{
+    for(int i = 0; i < packer->workerCount; i++)
+        freeData(packer->workers[i]);
+    free(packer->workers);
+    freePages(packer);
+    decodeCache_free(packer->decodeCache);
+    free(packer->placementOrder);
+    free(packer->crossoverScratch);
+    free(packer->sortScratch);
+    free(packer->slopeDirections);
+    free(packer->placements);
+    free(packer->cells);
+    free(packer->rayRise);
+    free(packer->dirty);
+    free(packer->dirtyTiles);
+    free(packer);
+}
+
+typedef struct
+{
+    SpritePacking *packer;
+    void **chromosomes;
+    Score *scores;
+    int count;
+    int cutoff;
+    int chunkCount;
+}Batch;
+
+// Evaluation, mutation and crossover are instantiated once per encoding, 
+// error term and alignment from spritePackingVariant.c, see selectVariant.
+#define VARIANT_ENCODING POS_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 0
+#define VARIANT_ALIGNED 0
+#define VARIANT(name) name##_posCartesian
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING POS_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 0
+#define VARIANT_ALIGNED 1
+#define VARIANT(name) name##_posCartesianAligned
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING POS_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 1
+#define VARIANT_ALIGNED 0
+#define VARIANT(name) name##_posCartesianNoError
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING POS_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 1
+#define VARIANT_ALIGNED 1
+#define VARIANT(name) name##_posCartesianNoErrorAligned
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_DIRECTION
+#define VARIANT_DISABLE_ERROR_TERM 0
+#define VARIANT_ALIGNED 0
+#define VARIANT(name) name##_movDirection
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_DIRECTION
+#define VARIANT_DISABLE_ERROR_TERM 0
+#define VARIANT_ALIGNED 1
+#define VARIANT(name) name##_movDirectionAligned
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_DIRECTION
+#define VARIANT_DISABLE_ERROR_TERM 1
+#define VARIANT_ALIGNED 0
+#define VARIANT(name) name##_movDirectionNoError
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_DIRECTION
+#define VARIANT_DISABLE_ERROR_TERM 1
+#define VARIANT_ALIGNED 1
+#define VARIANT(name) name##_movDirectionNoErrorAligned
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 0
+#define VARIANT_ALIGNED 0
+#define VARIANT(name) name##_movCartesian
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 0
+#define VARIANT_ALIGNED 1
+#define VARIANT(name) name##_movCartesianAligned
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 1
+#define VARIANT_ALIGNED 0
+#define VARIANT(name) name##_movCartesianNoError
+#include "spritePackingVariant.c"
+#define VARIANT_ENCODING MOV_CARTESIAN
+#define VARIANT_DISABLE_ERROR_TERM 1
+#define VARIANT_ALIGNED 1
+#define VARIANT(name) name##_movCartesianNoErrorAligned
+#include "spritePackingVariant.c"
+
+typedef struct
+{
+    Score (*calculateScore)(Problem *problem, void *chromosom, int cutoff);
+    void (*calculateScoreBatch)(Problem *problem, void **chromosomes, int count, 
+                                int cutoff, Score *scores);
+    void (*crossover)(Problem *problem, void *mother, void *father, 
+                      void *child0, void *child1);
+    void (*mutate)(Problem *problem, float mutationRate, float mutationDistance, 
+                   void *chromosom);
+}Variant;
+
+// Mutation and crossover don't depend on the error term or the alignment
+#define VARIANT_ENTRY(encoding, suffix) \
+    {spritePacking_calculateScore_##encoding##suffix, \
+     spritePacking_calculateScoreBatch_##encoding##suffix, \
+     spritePacking_crossover_##encoding, spritePacking_mutate_##encoding}
+#define VARIANT_ROW(encoding) \
+    { \
+        {VARIANT_ENTRY(encoding, ), VARIANT_ENTRY(encoding, Aligned)}, \
+        {VARIANT_ENTRY(encoding, NoError), VARIANT_ENTRY(encoding, NoErrorAligned)}, \
+    }
+
+// Indexed by the encoding, disableErrorTerm and whether alignment is above 1
+static const Variant variants[3][2][2] =
+{
+    [POS_CARTESIAN] = VARIANT_ROW(posCartesian),
+    [MOV_DIRECTION] = VARIANT_ROW(movDirection),
+    [MOV_CARTESIAN] = VARIANT_ROW(movCartesian),
+};
+
+// Points the hot callbacks of problem to the variant for its settings, so 
+// their loops don't test the encoding, the error term or the alignment
+static void selectVariant(Problem *problem)
+{
+    SpritePacking *packer = (SpritePacking *)problem->data;
+    SpritePackerSettings *settings = &packer->settings;
+    const Variant *variant = 
+        &variants[settings->positionEncoding][settings->disableErrorTerm][settings->alignment > 1];
+    problem->calculateScore = variant->calculateScore;
+    problem->calculateScoreBatch = variant->calculateScoreBatch;
+    problem->crossover = variant->crossover;
+    problem->mutate = variant->mutate;
+}
+
+// The bounding box of a valid packing holds the area of all sprites and the 
+// largest sprite in each dimension. Solid sprites wider than half the box
+// can't share a row and solid sprites taller than half the box can't share a 
+// column. The bound is the smallest box that satisfies all of that.
+// With pages it is the least number of full pages that hold the area, plus the
+// smallest sprite on the last one. All of it is computed on the padded masks,
+// the padding is taken off the final box.
+int spritePacking_lowerBound(Problem *problem)
+{
+    SpritePacking *packer = (SpritePacking *)problem->data;
+    int area = 0;
+    int maxWidth = 0;
+    int maxHeight = 0;
+    int minBox = INT_MAX;
+    int padding = packer->settings.padding;
+    bool *solid = malloc(packer->spriteCount * sizeof (bool));
+    for(int i = 0; i < packer->spriteCount; i++)
+    {
+        Sprite sprite = packer->sprites[i];
+        int spriteArea = 0;
+        for(int cell = 0; cell < sprite.dim.x * sprite.dim.y; cell++)
+            spriteArea += sprite.cells[cell] != 0;
+        area += spriteArea;
+        solid[i] = spriteArea == sprite.dim.x * sprite.dim.y;
+        maxWidth = MAX(maxWidth, sprite.dim.x);
+        maxHeight = MAX(maxHeight, sprite.dim.y);
+        minBox = MIN(minBox, (sprite.dim.x - padding) * (sprite.dim.y - padding));
+    }
+    if(isPaged(packer))
+    {
+        free(solid);
+        Vector2 pageSize = packer->settings.pageSize;
+        int paddedArea = (pageSize.x + padding) * (pageSize.y + padding);
+        int pages = (area + paddedArea - 1) / paddedArea;
+        return (pages - 1) * pageSize.x * pageSize.y + minBox;
+    }
+    int best = INT_MAX;
+    for(int width = maxWidth; width <= packer->bounds.x; width++)
+    {
+        int height = MAX(maxHeight, (area + width - 1) / width);
+        int stackedHeight = 0;
+        for(int i = 0; i < packer->spriteCount; i++)
+            if(solid[i] && 2 * packer->sprites[i].dim.x > width)
+                stackedHeight += packer->sprites[i].dim.y;
+        height = MAX(height, stackedHeight);
+        for(; height <= packer->bounds.y; height++)
         {
-            int realX = horizontal ? x : y;
-            int realY = horizontal ? y : x;
-            if(doesSpriteFit(packer, sprite, realX, realY) || x + 1 >= maxX)
-            {
-                chromosom[index].position = (Vector2){.x = realX, .y = realY};
-                blitSprite(packer, sprite, realX, realY);
+            int stackedWidth = 0;
+            for(int i = 0; i < packer->spriteCount; i++)
+                if(solid[i] && 2 * packer->sprites[i].dim.y > height)
+                    stackedWidth += packer->sprites[i].dim.x;
+            if(stackedWidth <= width)
                 break;
-            }
-            if(D > 0)
-            {
-                y++;
-                D -= 2 * dx;
-            }
-            D += 2 * dy;
         }
+        if(height <= packer->bounds.y)
+            best = MIN(best, (width - padding) * (height - padding));
     }
-    if(packer->settings.positionEncoding == MOV_CARTESIAN)
-        qsort(chromosom, packer->spriteCount, sizeof(Chromosom), chromosom_index);
+    free(solid);
+    return best;
 }
 
-Score spritePacking_calculateScore(Problem *problem, void *chromosomData)
+// Atlas position of the shape of a gene, without the extrusion and the padding
+static Vector2 shapePosition(SpritePacking *packer, Chromosom *gene)
 {
+    Vector2 extrusion = {.x = packer->settings.extrusion, .y = packer->settings.extrusion};
+    return vector2_add(gene->position, extrusion);
+}
+
+// Placement list: atlas position and size of every sprite, its direction gene
+// and its page, after the problem name and the sprite count. The shapes are 
+// in the problem file. Formatted into one buffer and written at once.
+void spritePacking_printChromosom(Problem *problem, void *chromosomData, FILE *file)
+{
+    assert(file);
     SpritePacking *packer = (SpritePacking *)problem->data;
     Chromosom *chromosom = (Chromosom *)chromosomData;
-    if(packer->settings.positionEncoding == MOV_CARTESIAN ||
-       packer->settings.positionEncoding == MOV_DIRECTION)
+    PROFILE_BEGIN(PHASE_TRACE_IO);
+    size_t capacity = strlen(problem->name) + 128 + packer->spriteCount * 96;
+    char *buffer = malloc(capacity);
+    size_t length = snprintf(buffer, capacity, 
+                             "problem,spriteCount\n%s, %i\nindex,x,y,width,height,direction,page\n",
+                             problem->name, packer->spriteCount);
+    for(int i = 0; i < packer->spriteCount; i++)
     {
-        calculatePositions(packer, chromosom);
+        Vector2 pos = shapePosition(packer, &chromosom[i]);
+        Vector2 dim = packer->shapes[chromosom[i].index].dim;
+        length += snprintf(buffer + length, capacity - length, "%i, %i, %i, %i, %i, %.6f, %i\n",
+                           chromosom[i].index, pos.x, pos.y, dim.x, dim.y, 
+                           chromosom[i].direction, chromosom[i].page);
     }
-    memset(packer->cells, 0, packer->cellCount);
-        for(int i = 0; i < packer->spriteCount; i++)
+    assert(length < capacity);
+    fwrite(buffer, 1, length, file);
+    free(buffer);
+    PROFILE_END(PHASE_TRACE_IO);
+}
+
+// Indexed PNG of the layout, pixel value sprite index + 1 (wrapping around 
+// after 255 sprites). Pages are drawn side by side.
+void spritePacking_writeImage(Problem *problem, void *chromosomData, FILE *file)
+{
+    SpritePacking *packer = (SpritePacking *)problem->data;
+    Chromosom *chromosom = (Chromosom *)chromosomData;
+    PROFILE_BEGIN(PHASE_TRACE_IO);
+    int pageStride = packer->settings.pageSize.x + 1;
+    Vector2 positions[packer->spriteCount];
+    Vector2 min = {.x = INT_MAX, .y = INT_MAX};
+    Vector2 max = {.x = INT_MIN, .y = INT_MIN};
+    for(int i = 0; i < packer->spriteCount; i++)
+    {
+        positions[i] = shapePosition(packer, &chromosom[i]);
+        if(isPaged(packer))
+            positions[i].x += chromosom[i].page * pageStride;
+        Vector2 dim = packer->shapes[chromosom[i].index].dim;
+        min = vector2_min(min, positions[i]);
+        max = vector2_max(max, vector2_add(positions[i], dim));
+    }
+    Vector2 size = vector2_sub(max, min);
+    uint8_t *pixels = calloc((size_t)size.x * size.y, 1);
+    for(int i = 0; i < packer->spriteCount; i++)
+    {
+        Sprite shape = packer->shapes[chromosom[i].index];
+        Vector2 origin = vector2_sub(positions[i], min);
+        uint8_t value = chromosom[i].index % 255 + 1;
+        for(int y = 0; y < shape.dim.y; y++)
+        {
+            uint8_t *target = pixels + (size_t)(origin.y + y) * size.x + origin.x;
+            for(int x = 0; x < shape.dim.x; x++)
+                if(shape.cells[x + y * shape.dim.x])
+                    target[x] = value;
+        }
+    }
+    //Evenly spread hues
+    uint8_t palette[256][3] = {{0}};
+    for(int i = 1; i < 256; i++)
+    {
+        float hue = fmodf(i * 0.618034f, 1) * 6;
+        float fraction = hue - (int)hue;
+        uint8_t rising = 55 + 200 * fraction;
+        uint8_t falling = 255 - 200 * fraction;
+        uint8_t colors[6][3] =
+        {
+            {255, rising, 55}, {falling, 255, 55}, {55, 255, rising},
+            {55, falling, 255}, {rising, 55, 255}, {255, 55, falling},
+        };
+        memcpy(palette[i], colors[(int)hue % 6], 3);
+    }
+    png_writeIndexed(file, size.x, size.y, pixels, palette);
+    free(pixels);
+    PROFILE_END(PHASE_TRACE_IO);
+}
+
+// Direction of the decoder ray that passes through position
+static float directionTo(SpritePacking *packer, Vector2 position)
+{
+    Vector2 bounds = positionBounds(packer);
+    if(position.x == 0 && position.y == 0)
+        return 0;
+    double horizontal = position.x > 0 ? 
+        (double)position.y / position.x * bounds.x / (2.0 * bounds.y) : 1;
+    if(horizontal < 0.5)
+        return horizontal;
+    return CLAMP(1 - (double)position.x / position.y * bounds.y / (2.0 * bounds.x), 0.5, 1);
+}
+
+static Layout layout_allocate(int spriteCount)
+{
+    return (Layout)
+    {
+        .positions = calloc(spriteCount, sizeof (Vector2)),
+        .pages = calloc(spriteCount, sizeof (int)),
+    };
+}
+
+// Shelf packing: the sprites by decreasing height, left to right in rows of
+// at most width cells from origin. With pages, a row that doesn't fit below 
+// the previous one starts the next page.
+static void shelfPack(SpritePacking *packer, int *sprites, int count, 
+                      Vector2 origin, int page, int width, Layout layout)
+{
+    for(int i = 1; i < count; i++)
+    {
+        int sprite = sprites[i];
+        int j = i;
+        for(; j > 0 && packer->sprites[sprites[j - 1]].dim.y < packer->sprites[sprite].dim.y; j--)
+            sprites[j] = sprites[j - 1];
+        sprites[j] = sprite;
+    }
+    int alignment = packer->settings.alignment;
+    int pageHeight = positionBounds(packer).y - 1;
+    Vector2 cursor = origin;
+    int rowHeight = 0;
+    for(int i = 0; i < count; i++)
+    {
+        Vector2 dim = packer->sprites[sprites[i]].dim;
+        if(cursor.x + dim.x > origin.x + width && cursor.x > origin.x)
         {
-            Vector2 position = chromosom[i].position;
-            Sprite sprite = packer->sprites[chromosom[i].index];
-            blitSprite(packer, sprite, position.x, position.y);
+            cursor.x = origin.x;
+            cursor.y = alignUp(cursor.y + rowHeight, alignment);
+            rowHeight = 0;
         }
-    int minX = INT_MAX;
-    int minY = INT_MAX;
-    int maxX = INT_MIN;
-    int maxY = INT_MIN;
-    int overlap = 0;
-    uint8_t *cell = packer->cells;
-    for(int y = 0; y < packer->bounds.y; y++)
-    {
-        for(int x = 0; x < packer->bounds.x; x++)
+        if(isPaged(packer) && cursor.y + dim.y > pageHeight && cursor.y > origin.y)
         {
-            if(*cell)
+            cursor = origin;
+            page = MIN(page + 1, packer->settings.pageCount - 1);
+        }
+        layout.positions[sprites[i]] = cursor;
+        layout.pages[sprites[i]] = page;
+        cursor.x = alignUp(cursor.x + dim.x, alignment);
+        rowHeight = MAX(rowHeight, dim.y);
+    }
+}
+
+// Rows about as wide as the packing is high
+static int shelfWidth(SpritePacking *packer, int *sprites, int count)
+{
+    if(isPaged(packer))
+        return positionBounds(packer).x - 1;
+    int area = 0;
+    int width = 0;
+    for(int i = 0; i < count; i++)
+    {
+        Vector2 dim = packer->sprites[sprites[i]].dim;
+        area += dim.x * dim.y;
+        width = MAX(width, dim.x);
+    }
+    return MAX(width, (int)ceil(sqrt(area)));
+}
+
+static Layout shelfLayout(SpritePacking *packer)
+{
+    Layout layout = layout_allocate(packer->spriteCount);
+    int sprites[packer->spriteCount];
+    for(int i = 0; i < packer->spriteCount; i++)
+        sprites[i] = i;
+    shelfPack(packer, sprites, packer->spriteCount, (Vector2){0}, 0, 
+              shelfWidth(packer, sprites, packer->spriteCount), layout);
+    return layout;
+}
+
+// One sprite of a best result CSV. Placement lists only give its box, older
+// per cell CSVs its cells.
+typedef struct
+{
+    bool present;
+    bool hasCells;
+    Vector2 min;
+    Vector2 max;
+    int cellCount;
+    Vector2 *cells;
+    int page;
+    bool used;
+}SeedShape;
+
+static SeedShape *seedShape_get(SeedShape **seeds, int *seedCount, int index)
+{
+    assert(index >= 0);
+    if(index >= *seedCount)
+    {
+        *seeds = realloc(*seeds, (index + 1) * sizeof (SeedShape));
+        for(int i = *seedCount; i <= index; i++)
+            (*seeds)[i] = (SeedShape)
             {
-                minX = MIN(minX, x);
-                minY = MIN(minY, y);
-                maxX = MAX(maxX, x);
-                maxY = MAX(maxY, y);
-                overlap += *cell - 1;
+                .min = {.x = INT_MAX, .y = INT_MAX},
+                .max = {.x = INT_MIN, .y = INT_MIN},
+            };
+        *seedCount = index + 1;
+    }
+    (*seeds)[index].present = true;
+    return &(*seeds)[index];
+}
+
+// Without exact only the size has to match. Exact compares the cells, or the
+// index if the cells aren't known.
+static bool seedShape_matches(SeedShape *seed, int seedIndex, Sprite shape, int index, 
+                              bool exact)
+{
+    Vector2 dim = vector2_add(vector2_sub(seed->max, seed->min), (Vector2){.x = 1, .y = 1});
+    if(!seed->present || seed->used || dim.x != shape.dim.x || dim.y != shape.dim.y)
+        return false;
+    if(!exact)
+        return true;
+    if(!seed->hasCells)
+        return seedIndex == index;
+    int shapeCells = 0;
+    for(int i = 0; i < shape.dim.x * shape.dim.y; i++)
+        shapeCells += shape.cells[i] != 0;
+    if(shapeCells != seed->cellCount)
+        return false;
+    for(int i = 0; i < seed->cellCount; i++)
+    {
+        Vector2 cell = vector2_sub(seed->cells[i], seed->min);
+        if(!shape.cells[cell.x + cell.y * shape.dim.x])
+            return false;
+    }
+    return true;
+}
+
+// Reads the per cell CSV of earlier versions, pages are side by side
+static void readCells(SpritePacking *packer, FILE *file, SeedShape **seeds, int *seedCount)
+{
+    int x, y, index;
+    while(fscanf(file, "%i, %i, %i\n", &x, &y, &index) == 3)
+    {
+        SeedShape *seed = seedShape_get(seeds, seedCount, index);
+        seed->hasCells = true;
+        if((seed->cellCount & (seed->cellCount - 1)) == 0)
+            seed->cells = realloc(seed->cells, MAX(seed->cellCount * 2, 1) * sizeof (Vector2));
+        Vector2 cell = {.x = x, .y = y};
+        seed->cells[seed->cellCount++] = cell;
+        seed->min = vector2_min(seed->min, cell);
+        seed->max = vector2_max(seed->max, cell);
+    }
+    int pageStride = packer->settings.pageSize.x + 1;
+    for(int i = 0; i < *seedCount && isPaged(packer); i++)
+    {
+        SeedShape *seed = &(*seeds)[i];
+        if(!seed->present)
+            continue;
+        seed->page = MIN(seed->min.x / pageStride, packer->settings.pageCount - 1);
+        for(int k = 0; k < seed->cellCount; k++)
+            seed->cells[k].x -= seed->page * pageStride;
+        seed->min.x -= seed->page * pageStride;
+        seed->max.x -= seed->page * pageStride;
+    }
+}
+
+static void readPlacements(SpritePacking *packer, FILE *file, SeedShape **seeds, int *seedCount)
+{
+    fscanf(file, "%*[^\n]\n%*[^\n]\n");
+    int index, x, y, width, height, page;
+    float direction;
+    while(fscanf(file, "%i, %i, %i, %i, %i, %f, %i\n", 
+                 &index, &x, &y, &width, &height, &direction, &page) == 7)
+    {
+        SeedShape *seed = seedShape_get(seeds, seedCount, index);
+        seed->min = (Vector2){.x = x, .y = y};
+        seed->max = (Vector2){.x = x + width - 1, .y = y + height - 1};
+        seed->page = isPaged(packer) ? MIN(page, packer->settings.pageCount - 1) : 0;
+    }
+}
+
+// Reads a layout written by spritePacking_printChromosom. Sprites are matched
+// by shape rather than index: first identical shapes, then shapes of the 
+// same size. Sprites that match nothing are shelf packed to the right of 
+// the layout, or on the pages after it.
+static Layout readLayout(SpritePacking *packer, char *path)
+{
+    FILE *file = fopen(path, "r");
+    assert(file);
+    int seedCount = 0;
+    SeedShape *seeds = NULL;
+    char header[64] = {0};
+    fscanf(file, "%63[^\n]\n", header);
+    if(strncmp(header, "problem", 7) == 0)
+        readPlacements(packer, file, &seeds, &seedCount);
+    else
+        readCells(packer, file, &seeds, &seedCount);
+    fclose(file);
+
+    Vector2 offset = {.x = packer->settings.extrusion, .y = packer->settings.extrusion};
+    int lastPage = -1;
+    int right = 0;
+    for(int i = 0; i < seedCount; i++)
+    {
+        if(!seeds[i].present)
+            continue;
+        lastPage = MAX(lastPage, seeds[i].page);
+        right = MAX(right, seeds[i].max.x + 1 + offset.x + packer->settings.padding);
+    }
+
+    Layout layout = layout_allocate(packer->spriteCount);
+    bool placed[packer->spriteCount];
+    memset(placed, 0, sizeof (placed));
+    for(int pass = 0; pass < 2; pass++)
+    {
+        for(int i = 0; i < packer->spriteCount; i++)
+        {
+            for(int k = 0; k < seedCount && !placed[i]; k++)
+            {
+                if(!seedShape_matches(&seeds[k], k, packer->shapes[i], i, pass == 0))
+                    continue;
+                seeds[k].used = true;
+                placed[i] = true;
+                layout.positions[i] = vector2_sub(seeds[k].min, offset);
+                layout.pages[i] = seeds[k].page;
             }
-            cell++;
         }
     }
-    int width = maxX - minX + 1;
-    int height = maxY - minY + 1;
-    int error = MAX(packer->bounds.x, packer->bounds.y) * overlap;
-    if(error > packer->bounds.x * packer->bounds.y)
-        error = packer->bounds.x * packer->bounds.y;
-    if(packer->settings.disableErrorTerm)
-        error = 0;
-    Score Result =
-    {
-        .score = width * height + error,
-        .rawScore = width * height,
-        .overlap = overlap
-    };
-    return Result;
+    int added[packer->spriteCount];
+    int addedCount = 0;
+    for(int i = 0; i < packer->spriteCount; i++)
+        if(!placed[i])
+            added[addedCount++] = i;
+    if(isPaged(packer))
+        shelfPack(packer, added, addedCount, (Vector2){0}, 
+                  MIN(lastPage + 1, packer->settings.pageCount - 1), 
+                  shelfWidth(packer, added, addedCount), layout);
+    else
+        shelfPack(packer, added, addedCount, (Vector2){.x = alignUp(right, packer->settings.alignment)}, 
+                  0, shelfWidth(packer, added, addedCount), layout);
+    for(int i = 0; i < seedCount; i++)
+        free(seeds[i].cells);
+    free(seeds);
+    return layout;
 }
 
-void spritePacking_printChromosom(Problem *problem, void *chromosomData, FILE *file)
+// Rebuilds the seed layouts for the current settings
+static void prepareSeeds(SpritePacking *packer)
+{
+    for(int i = 0; i < packer->seedCount; i++)
+    {
+        free(packer->seeds[i].positions);
+        free(packer->seeds[i].pages);
+    }
+    free(packer->seeds);
+    SpritePackerSettings *settings = &packer->settings;
+    packer->seedCount = 0;
+    packer->seeds = malloc((settings->seedFileCount + 1) * sizeof (Layout));
+    if(settings->shelfSeed)
+        packer->seeds[packer->seedCount++] = shelfLayout(packer);
+    for(int i = 0; i < settings->seedFileCount; i++)
+        packer->seeds[packer->seedCount++] = readLayout(packer, settings->seedFiles[i]);
+}
+
+// Fills chromosom with the seed layout, the MOV_* encodings get the rays
+// that pass through its positions.
+bool spritePacking_seedChromosom(Problem *problem, int seed, void *chromosomData)
 {
-    assert(file);
     SpritePacking *packer = (SpritePacking *)problem->data;
     Chromosom *chromosom = (Chromosom *)chromosomData;
-    fprintf(file, "x,y,index\n");
+    if(seed >= packer->seedCount)
+        return false;
+    Layout layout = packer->seeds[seed];
     for(int i = 0; i < packer->spriteCount; i++)
     {
-        Vector2 pos = chromosom[i].position;
-        int spriteIndex = chromosom[i].index;
-        Sprite sprite = packer->sprites[spriteIndex];
-        for(int y = 0; y < sprite.dim.y; y++)
+        chromosom[i] = (Chromosom)
         {
-            for(int x = 0; x < sprite.dim.x; x++)
-            {
-                if(sprite.cells[y * sprite.dim.x + x])
-                    fprintf(file, "%i, %i, %i\n", x + pos.x, y + pos.y, spriteIndex);
-            }
-        }
+            .index = i,
+            .position = layout.positions[i],
+            .page = layout.pages[i],
+        };
+        clampPosition(packer, &chromosom[i]);
+        chromosom[i].direction = directionTo(packer, chromosom[i].position);
     }
+    return true;
 }
 
 void spritePacking_printProblem(int width, int height, uint8_t *indexes, FILE *file)
@@ -436,30 +1794,21 @@ void spritePacking_printProblem(int width, int height, uint8_t *indexes, FILE *f
 SpritePacking *spritePacking_createFromShapes(int spriteCount, Sprite *sprites)
 {
     assert(spriteCount > 0);
-    int totalWidth = 0;
-    int totalHeight = 0;
-    int maxWidth = 0;
-    int maxHeight = 0;
     for(int i = 0; i < spriteCount; i++)
-    {
-        totalWidth += sprites[i].dim.x;
-        totalHeight += sprites[i].dim.y;
-        maxWidth = MAX(maxWidth, sprites[i].dim.x);
-        maxHeight = MAX(maxHeight, sprites[i].dim.y);
-    }
-    int cellWidth = totalWidth;
-    int cellHeight = totalHeight;
-    int cellCount = cellWidth * cellHeight;
+        shape_compileSpans(&sprites[i]);
     SpritePacking *result = malloc(sizeof (SpritePacking));
     *result = (SpritePacking)
     {
         .spriteCount = spriteCount,
+        .shapes = sprites,
         .sprites = sprites,
-        .bounds.x = cellWidth,
-        .bounds.y = cellHeight,
-        .cellCount = cellCount,
-        .cells = calloc(cellCount, sizeof (result->cells[0]))
+        .placementOrder = malloc(spriteCount * sizeof (int)),
+        .crossoverScratch = malloc(spriteCount * CROSSOVER_SCRATCH * sizeof (int)),
+        .sortScratch = malloc(spriteCount * SORT_SCRATCH),
+        .slopeDirections = createSlopeDirections(),
+        .placements = malloc(spriteCount * sizeof (Placement)),
     };
+    allocateGrid(result, canvasBounds(sprites, spriteCount));
     return result;
 }
 
@@ -513,7 +1862,23 @@ SpritePacking *spritePacking_createFromIndexes(int width,
 void spritePacking_setSettings(Problem *problem, SpritePackerSettings settings)
 {
     SpritePacking *packer = (SpritePacking *)problem->data;
+    resetScratch(packer);
     packer->settings = settings;
+    prepareSprites(packer);
+    prepareSeeds(packer);
+    selectVariant(problem);
+}
+
+Problem spritePacking_clone(Problem *problem)
+{
+    Problem result = *problem;
+    result.data = cloneData((SpritePacking *)problem->data);
+    return result;
+}
+
+void spritePacking_freeClone(Problem *problem)
+{
+    freeData((SpritePacking *)problem->data);
 }
 
 Problem spritePacking_createProblemFromIndexes(Sprites sprites)
@@ -528,11 +1893,16 @@ Problem spritePacking_createProblemFromIndexes(Sprites sprites)
         .height = sprites.height,
         .chromosomSize = sizeof(Chromosom[packing->spriteCount]),
         .initializeChromosom = spritePacking_initializeChromosom,
-        .calculateScore = spritePacking_calculateScore,
-        .crossover = spritePacking_crossover,
-        .mutate = spritePacking_mutate,
-        .printChromosom = spritePacking_printChromosom
+        .distance = spritePacking_distance,
+        .localMove = spritePacking_localMove,
+        .printChromosom = spritePacking_printChromosom,
+        .writeImage = spritePacking_writeImage,
+        .seedChromosom = spritePacking_seedChromosom,
+        .lowerBound = spritePacking_lowerBound,
+        .clone = spritePacking_clone,
+        .freeClone = spritePacking_freeClone
     };
+    selectVariant(&problem);
     printf("%s bounds: [%i, %i]\n", problem.name, packing->bounds.x, packing->bounds.y);
     return problem;
 }
@@ -0,0 +1,619 @@
+// Template of the evaluation, mutation and crossover, included by 
+// spritePacking.c once per encoding, error term and alignment. 
+// VARIANT_ENCODING, VARIANT_DISABLE_ERROR_TERM and VARIANT_ALIGNED are 
+// constants, so their branches fold at compile time. VARIANT(name) appends 
+// the suffix of the variant.
+
+// Decoder order of the MOV_* encodings: the chromosom index of every step in
+// placementOrder and the sprite and ray direction in placements. The 
+// chromosom itself is not reordered.
+static void VARIANT(buildPlacements)(SpritePacking *packer, Chromosom *chromosom)
+{
+    int spriteCount = packer->spriteCount;
+    int *order = packer->placementOrder;
+    Placement *placements = packer->placements;
+    if(VARIANT_ENCODING == MOV_CARTESIAN)
+    {
+        sortByDistance(packer, chromosom, order);
+        for(int i = 0; i < spriteCount; i++)
+        {
+            Chromosom *gene = &chromosom[order[i]];
+            placements[i] = (Placement)
+            {
+                .sprite = gene->index,
+                .direction = positionDirection(packer, gene->position),
+            };
+        }
+    }
+    else
+    {
+        for(int i = 0; i < spriteCount; i++)
+            order[chromosom[i].index] = i;
+        for(int i = 0; i < spriteCount; i++)
+            placements[i] = (Placement)
+            {
+                .sprite = i,
+                .direction = chromosom[order[i]].direction * DIRECTION_STEPS + 0.5f,
+            };
+    }
+}
+
+// Snaps value up to a multiple of the local alignment. The unaligned variants
+// use the value as is.
+#define VARIANT_ALIGN_UP(value) \
+    (VARIANT_ALIGNED ? ((value) + alignment - 1) / alignment * alignment : (value))
+
+// Walks the ray of direction from the origin until the sprite fits and blits
+// it there. Sprites that don't fit anywhere end up at the end of the ray, 
+// which is where the next step would leave the grid.
+// After a collision the ray skips every step that is known to collide as 
+// well: along a run of occupied cells in the direction of the ray, as long
+// as the minor coordinate doesn't change.
+// With VARIANT_ALIGNED the steps are snapped up to multiples of the alignment
+// and steps that snap to the position tested last are skipped.
+static Vector2 VARIANT(placeSprite)(SpritePacking *packer, Sprite sprite, int direction)
+{
+    assert(direction >= 0);
+    assert(direction <= DIRECTION_STEPS);
+    Vector2 bounds = vector2_sub(packer->bounds, sprite.dim);
+    bool horizontal = direction < DIRECTION_STEPS / 2;
+    int dx, maxX, maxY;
+    int dy = packer->rayRise[direction];
+    if(horizontal)
+    {
+        dx = packer->bounds.x;
+        maxX = bounds.x;
+        maxY = bounds.y;
+    }
+    else
+    {
+        dx = packer->bounds.y;
+        maxX = bounds.y;
+        maxY = bounds.x;
+    }
+    int alignment = VARIANT_ALIGNED ? packer->settings.alignment : 1;
+    Vector2 position = {0};
+    int y = 0;
+    int D = 2 * dy - dx;
+    int skipUntil = 0;
+    int skipY = 0;
+    int lastX = -1;
+    int lastY = -1;
+    PROFILE_COUNT(COUNTER_PLACEMENTS, 1);
+    for(int x = 0; x < dx; x++)
+    {
+        PROFILE_COUNT(COUNTER_RAY_STEPS, 1);
+        int alignedX = VARIANT_ALIGN_UP(x);
+        int alignedY = VARIANT_ALIGN_UP(y);
+        int realX = horizontal ? alignedX : alignedY;
+        int realY = horizontal ? alignedY : alignedX;
+        bool fits = false;
+        if((alignedX >= skipUntil || alignedY != skipY) && 
+           (alignedX != lastX || alignedY != lastY))
+        {
+            Vector2 cell;
+            Span span;
+            lastX = alignedX;
+            lastY = alignedY;
+            fits = findCollision(packer, sprite, realX, realY, &cell, &span);
+            if(!fits)
+            {
+                skipY = alignedY;
+                if(horizontal)
+                    skipUntil = occupiedRunEnd(packer, cell, true) - span.start + 1;
+                else
+                    skipUntil = alignedX + occupiedRunEnd(packer, cell, false) - cell.y + 1;
+            }
+        }
+        int nextY = D > 0 ? y + 1 : y;
+        if(fits || VARIANT_ALIGN_UP(x + 1) >= maxX || VARIANT_ALIGN_UP(nextY) >= maxY)
+        {
+            position = (Vector2){.x = realX, .y = realY};
+            blitSprite(packer, sprite, realX, realY);
+            break;
+        }
+        if(D > 0)
+        {
+            y++;
+            D -= 2 * dx;
+        }
+        D += 2 * dy;
+    }
+    return position;
+}
+
+// Places the sprites in decoder order and stores the result in chromosom. 
+// With the decode cache, the longest placement prefix shared with an earlier
+// layout is restored instead of placed again. 
+static void VARIANT(calculatePositions)(SpritePacking *packer, Chromosom *chromosom)
+{
+    PROFILE_BEGIN(PHASE_CALCULATE_POSITIONS);
+    int spriteCount = packer->spriteCount;
+    int *order = packer->placementOrder;
+    Placement *placements = packer->placements;
+    VARIANT(buildPlacements)(packer, chromosom);
+    if(packer->settings.decodeCacheSize > 0 && !packer->decodeCache)
+        packer->decodeCache = decodeCache_create(spriteCount, 
+                                                 packer->settings.decodeCacheSize,
+                                                 packer->settings.decodeCacheInterval);
+    DecodeCache *cache = packer->decodeCache;
+    clearCells(packer);
+
+    int step = 0;
+    DecodeTrace *trace = NULL;
+    if(cache)
+    {
+        int prefix;
+        DecodeTrace *source = decodeCache_findPrefix(cache, placements, spriteCount, &prefix);
+        if(source)
+        {
+            restorePrefix(packer, source, prefix, chromosom);
+            step = prefix;
+            source->lastUse = ++cache->clock;
+        }
+        //The new trace shares the snapshots inside the prefix with source
+        trace = decodeCache_victim(cache, source);
+        int sharedCount = source ? MIN(prefix / cache->interval, source->snapshotCount) : 0;
+        Snapshot *shared[sharedCount + 1];
+        for(int k = 0; k < sharedCount; k++)
+        {
+            shared[k] = source->snapshots[k];
+            shared[k]->refCount++;
+        }
+        for(int k = 0; k < trace->snapshotCount; k++)
+            snapshot_release(trace->snapshots[k]);
+        memcpy(trace->snapshots, shared, sharedCount * sizeof (Snapshot *));
+        trace->snapshotCount = sharedCount;
+        trace->length = 0;
+    }
+    for(; step < spriteCount; step++)
+    {
+        Chromosom *gene = &chromosom[order[step]];
+        Sprite sprite = packer->sprites[gene->index];
+        gene->position = VARIANT(placeSprite)(packer, sprite, placements[step].direction);
+        if(trace && (step + 1) % cache->interval == 0 && step + 1 < spriteCount)
+            trace->snapshots[trace->snapshotCount++] = takeSnapshot(packer);
+    }
+    if(trace)
+    {
+        memcpy(trace->placements, placements, spriteCount * sizeof (Placement));
+        for(int i = 0; i < spriteCount; i++)
+            trace->positions[i] = chromosom[order[i]].position;
+        trace->length = spriteCount;
+        trace->lastUse = ++cache->clock;
+    }
+    PROFILE_END(PHASE_CALCULATE_POSITIONS);
+}
+
+// With pages the error can grow up to the area of all pages, so that using
+// fewer pages never pays for overlap.
+static int VARIANT(errorTerm)(SpritePacking *packer, int overlap)
+{
+    if(VARIANT_DISABLE_ERROR_TERM)
+        return 0;
+    Vector2 size = packer->bounds;
+    int64_t limit = (int64_t)size.x * size.y;
+    if(isPaged(packer))
+    {
+        size = packer->settings.pageSize;
+        limit = (int64_t)size.x * size.y * packer->settings.pageCount;
+    }
+    int64_t error = (int64_t)MAX(size.x, size.y) * overlap;
+    return MIN(error, limit);
+}
+
+// Bounding box of the masks and overlap of the dirty tiles. Only dirty tiles can hold 
+// sprites, so the scan skips all others. The bounding box and the overlap only
+// grow while scanning, so the partial score after every tile is a lower bound
+// of the final score. Once it exceeds cutoff the scan stops and returns true.
+static bool VARIANT(scanTiles)(SpritePacking *packer, int cutoff, 
+                               Vector2 *min, Vector2 *max, int *overlap)
+{
+    int minX = INT_MAX;
+    int minY = INT_MAX;
+    int maxX = INT_MIN;
+    int maxY = INT_MIN;
+    int cellOverlap = 0;
+    int padding = packer->settings.padding;
+    bool rejected = false;
+    PROFILE_BEGIN(PHASE_SCORE_SCAN);
+    for(int i = 0; i < packer->dirtyCount && !rejected; i++)
+    {
+        Vector2 origin, size;
+        tileRect(packer, packer->dirtyTiles[i], &origin, &size);
+        uint8_t *line = packer->cells + origin.x + origin.y * packer->bounds.x;
+        for(int y = origin.y; y < origin.y + size.y; y++)
+        {
+            uint8_t *cell = line;
+            for(int x = origin.x; x < origin.x + size.x; x++)
+            {
+                if(*cell)
+                {
+                    minX = MIN(minX, x);
+                    minY = MIN(minY, y);
+                    maxX = MAX(maxX, x);
+                    maxY = MAX(maxY, y);
+                    cellOverlap += *cell - 1;
+                }
+                cell++;
+            }
+            line += packer->bounds.x;
+        }
+        if(cutoff < INT_MAX && maxX >= minX)
+        {
+            int width = MAX(maxX - minX + 1 - padding, 0);
+            int height = MAX(maxY - minY + 1 - padding, 0);
+            rejected = width * height + VARIANT(errorTerm)(packer, cellOverlap) > cutoff;
+        }
+    }
+    PROFILE_END(PHASE_SCORE_SCAN);
+    *min = (Vector2){.x = minX, .y = minY};
+    *max = (Vector2){.x = maxX, .y = maxY};
+    *overlap = cellOverlap;
+    return rejected;
+}
+
+// Places the sprites of one page on its own grid, in decoder order
+static void VARIANT(calculatePage)(void *data, int index)
+{
+    PageBatch *batch = (PageBatch *)data;
+    SpritePacking *packer = batch->packer;
+    int pageIndex = batch->usedPages[index];
+    SpritePacking *page = packer->pages[pageIndex];
+    bool moving = VARIANT_ENCODING != POS_CARTESIAN;
+    clearCells(page);
+    for(int i = packer->pageStart[pageIndex]; i < packer->pageStart[pageIndex + 1]; i++)
+    {
+        int step = packer->pageSteps[i];
+        Chromosom *gene = &batch->chromosom[moving ? packer->placementOrder[step] : step];
+        Sprite sprite = packer->sprites[gene->index];
+        if(moving)
+            gene->position = VARIANT(placeSprite)(page, sprite, packer->placements[step].direction);
+        else
+        {
+            clampPosition(packer, gene);
+            if(VARIANT_ALIGNED)
+                alignPosition(packer, gene);
+            blitSprite(page, sprite, gene->position.x, gene->position.y);
+        }
+    }
+    Vector2 min, max;
+    VARIANT(scanTiles)(page, INT_MAX, &min, &max, &batch->overlaps[index]);
+    int border = 1 - packer->settings.padding;
+    batch->sizes[index] = vector2_add(vector2_sub(max, min), (Vector2){.x = border, .y = border});
+    batch->areas[index] = batch->sizes[index].x * batch->sizes[index].y;
+}
+
+// Every page is a separate grid, evaluated on up to threadCount threads. The
+// score counts all used pages but the least filled one as full and adds the
+// bounding box of that one, so fewer pages always win and among equal page 
+// counts the emptiest last page. The cutoff isn't used.
+static Score VARIANT(calculatePagedScore)(SpritePacking *packer, Chromosom *chromosom,
+                                          int threadCount)
+{
+    ensurePages(packer);
+    int pageCount = packer->settings.pageCount;
+    int *pageStart = packer->pageStart;
+    bool moving = VARIANT_ENCODING != POS_CARTESIAN;
+    if(moving)
+        VARIANT(buildPlacements)(packer, chromosom);
+    PROFILE_BEGIN(PHASE_CALCULATE_POSITIONS);
+    memset(pageStart, 0, (pageCount + 1) * sizeof (int));
+    for(int step = 0; step < packer->spriteCount; step++)
+    {
+        int page = chromosom[moving ? packer->placementOrder[step] : step].page;
+        pageStart[page + 1]++;
+    }
+    int usedPages[pageCount];
+    int usedCount = 0;
+    for(int page = 0; page < pageCount; page++)
+    {
+        if(pageStart[page + 1] > 0)
+            usedPages[usedCount++] = page;
+        pageStart[page + 1] += pageStart[page];
+    }
+    int fill[pageCount];
+    memcpy(fill, pageStart, pageCount * sizeof (int));
+    for(int step = 0; step < packer->spriteCount; step++)
+    {
+        int page = chromosom[moving ? packer->placementOrder[step] : step].page;
+        packer->pageSteps[fill[page]++] = step;
+    }
+    int areas[usedCount];
+    Vector2 sizes[usedCount];
+    int overlaps[usedCount];
+    PageBatch batch =
+    {
+        .packer = packer,
+        .chromosom = chromosom,
+        .usedPages = usedPages,
+        .areas = areas,
+        .sizes = sizes,
+        .overlaps = overlaps,
+    };
+    int threads = MIN(MAX(threadCount, 1), usedCount);
+    if(threads > 1)
+        parallel_run(usedCount, threads, VARIANT(calculatePage), &batch);
+    else
+        for(int i = 0; i < usedCount; i++)
+            VARIANT(calculatePage)(&batch, i);
+    PROFILE_END(PHASE_CALCULATE_POSITIONS);
+
+    int least = 0;
+    int overlap = 0;
+    for(int i = 0; i < usedCount; i++)
+    {
+        overlap += overlaps[i];
+        if(areas[i] < areas[least])
+            least = i;
+    }
+    Vector2 pageSize = packer->settings.pageSize;
+    int rawScore = (usedCount - 1) * pageSize.x * pageSize.y + areas[least];
+    return (Score)
+    {
+        .score = rawScore + VARIANT(errorTerm)(packer, overlap),
+        .rawScore = rawScore,
+        .overlap = overlap,
+        .width = sizes[least].x,
+        .height = sizes[least].y,
+    };
+}
+
+// Returns the bound as a rejected score once the partial score exceeds cutoff,
+// see scanTiles. threadCount is for the pages.
+static Score VARIANT(calculateScore)(SpritePacking *packer, Chromosom *chromosom, int cutoff,
+                                     int threadCount)
+{
+    PROFILE_COUNT(COUNTER_EVALUATIONS, 1);
+    if(isPaged(packer))
+        return VARIANT(calculatePagedScore)(packer, chromosom, threadCount);
+    if(VARIANT_ENCODING == MOV_CARTESIAN ||
+       VARIANT_ENCODING == MOV_DIRECTION)
+    {
+        //Leaves every sprite blitted at its final position
+        VARIANT(calculatePositions)(packer, chromosom);
+    }
+    else
+    {
+        clearCells(packer);
+        for(int i = 0; i < packer->spriteCount; i++)
+        {
+            if(VARIANT_ALIGNED)
+                alignPosition(packer, &chromosom[i]);
+            Vector2 position = chromosom[i].position;
+            Sprite sprite = packer->sprites[chromosom[i].index];
+            blitSprite(packer, sprite, position.x, position.y);
+        }
+    }
+    Vector2 min, max;
+    int overlap;
+    bool rejected = VARIANT(scanTiles)(packer, cutoff, &min, &max, &overlap);
+    PROFILE_COUNT(COUNTER_REJECTED, rejected);
+    //The masks are padded at the right and bottom
+    int width = max.x - min.x + 1 - packer->settings.padding;
+    int height = max.y - min.y + 1 - packer->settings.padding;
+    int error = VARIANT(errorTerm)(packer, overlap);
+    Score Result =
+    {
+        .score = width * height + error,
+        .rawScore = width * height,
+        .overlap = overlap,
+        .width = width,
+        .height = height,
+        .rejected = rejected
+    };
+    return Result;
+}
+
+static Score VARIANT(spritePacking_calculateScore)(Problem *problem, void *chromosomData,
+                                                   int cutoff)
+{
+    SpritePacking *packer = (SpritePacking *)problem->data;
+    return VARIANT(calculateScore)(packer, (Chromosom *)chromosomData, cutoff, 
+                                   packer->settings.threadCount);
+}
+
+static void VARIANT(calculateScoreChunk)(void *data, int chunk)
+{
+    Batch *batch = (Batch *)data;
+    SpritePacking *packer = batch->packer->workers[chunk];
+    packer->settings = batch->packer->settings;
+    int begin = batch->count * chunk / batch->chunkCount;
+    int end = batch->count * (chunk + 1) / batch->chunkCount;
+    for(int i = begin; i < end; i++)
+        batch->scores[i] = VARIANT(calculateScore)(packer, (Chromosom *)batch->chromosomes[i], 
+                                                   batch->cutoff, 1);
+}
+
+// Scores count chromosomes in one go. With settings.threadCount > 1 they are
+// split into contiguous chunks that are scored on worker copies in parallel.
+static void VARIANT(spritePacking_calculateScoreBatch)(Problem *problem, void **chromosomes,
+                                                       int count, int cutoff, Score *scores)
+{
+    SpritePacking *packer = (SpritePacking *)problem->data;
+    int chunkCount = MIN(MAX(packer->settings.threadCount, 1), count);
+    if(chunkCount <= 1)
+    {
+        for(int i = 0; i < count; i++)
+            scores[i] = VARIANT(calculateScore)(packer, (Chromosom *)chromosomes[i], cutoff, 1);
+        return;
+    }
+    if(packer->workerCount < chunkCount)
+    {
+        packer->workers = realloc(packer->workers, chunkCount * sizeof (SpritePacking *));
+        for(int i = packer->workerCount; i < chunkCount; i++)
+            packer->workers[i] = cloneData(packer);
+        packer->workerCount = chunkCount;
+    }
+    Batch batch =
+    {
+        .packer = packer,
+        .chromosomes = chromosomes,
+        .scores = scores,
+        .count = count,
+        .cutoff = cutoff,
+        .chunkCount = chunkCount,
+    };
+    parallel_run(chunkCount, chunkCount, VARIANT(calculateScoreChunk), &batch);
+}
+
+#if !VARIANT_DISABLE_ERROR_TERM && !VARIANT_ALIGNED
+
+static void VARIANT(spritePacking_mutate)(Problem *problem, 
+                                          float mutationRate, 
+                                          float mutationDistance, 
+                                          void *chromosomData)
+{
+    SpritePacking *packer = (SpritePacking *)problem->data;
+    Chromosom *chromosom = (Chromosom *)chromosomData;
+    Vector2 bounds = positionBounds(packer);
+    bool paged = isPaged(packer);
+    PROFILE_BEGIN(PHASE_MUTATE);
+    for(int spriteIndex = 0; spriteIndex < packer->spriteCount; spriteIndex++)
+    {
+        for(int dimension = 0; dimension < 2; dimension++)
+        {
+            if(pcg32_fraction() <= mutationRate)
+            {
+                if(VARIANT_ENCODING == POS_CARTESIAN ||
+                   VARIANT_ENCODING == MOV_CARTESIAN)
+                {
+                    int maxDistance = bounds.i[dimension] * mutationDistance;
+                    int change =  pcg32_range(-maxDistance, maxDistance + 1);
+                    int *value = &chromosom[spriteIndex].position.i[dimension];
+                    int newValue = *value + change;
+                    int spriteSize = packer->sprites[spriteIndex].dim.i[dimension];
+                    *value = CLAMP(newValue, 0, bounds.i[dimension] - spriteSize - 1);
+                }
+                else if(VARIANT_ENCODING == MOV_DIRECTION)
+                {
+                    if(dimension == 0)
+                    {
+                        float change = (pcg32_fraction() - 0.5) * 2 * mutationDistance;
+                        float *value = &chromosom[spriteIndex].direction;
+                        *value = CLAMP(*value + change, 0, 1);
+                    }
+                    else
+                    {
+                        int p0 = pcg32_boundedrand(packer->spriteCount);
+                        int p1 = pcg32_boundedrand(packer->spriteCount);
+                        Chromosom tmp = chromosom[p0];
+                        chromosom[p0] = chromosom[p1];
+                        chromosom[p1] = tmp;
+                    }
+                }
+            }
+        }
+        if(paged && pcg32_fraction() <= mutationRate)
+            chromosom[spriteIndex].page = pcg32_boundedrand(packer->settings.pageCount);
+    }
+    PROFILE_END(PHASE_MUTATE);
+}
+
+static void VARIANT(spritePacking_crossover)(Problem *problem, 
+                                             void *motherData, void *fatherData, 
+                                             void *child0Data, void *child1Data)
+{
+    SpritePacking *packer = (SpritePacking *)problem->data;
+    Chromosom *mother = (Chromosom *)motherData;
+    Chromosom *father = (Chromosom *)fatherData;
+    Chromosom *child0 = (Chromosom *)child0Data;
+    Chromosom *child1 = (Chromosom *)child1Data;
+    int spriteCount = packer->spriteCount;
+    int *scratch = packer->crossoverScratch;
+    int *motherRank = scratch + 7 * spriteCount;
+    PROFILE_BEGIN(PHASE_CROSSOVER);
+
+    int segment[2];
+    switch(crossoverOperator(packer))
+    {
+        case CROSSOVER_POINT:
+        {
+            int crossover = pcg32_boundedrand(spriteCount);
+            memcpy(child0, mother, sizeof(Chromosom[crossover]));
+            memcpy(&child0[crossover], &father[crossover], 
+                    sizeof(Chromosom[spriteCount - crossover]));
+            memcpy(child1, father, sizeof(Chromosom[crossover]));
+            memcpy(&child1[crossover], &mother[crossover], 
+                    sizeof(Chromosom[spriteCount - crossover]));
+            break;
+        }
+        case CROSSOVER_UNIFORM:
+        {
+            uint32_t *mask = (uint32_t *)motherRank;
+            for(int i = 0; i < (spriteCount + 31) / 32; i++)
+                mask[i] = pcg32_random();
+            if(VARIANT_ENCODING == MOV_DIRECTION)
+            {
+                uniformOrderCrossover(child0, mother, father, mask, spriteCount, scratch);
+                uniformOrderCrossover(child1, father, mother, mask, spriteCount, scratch);
+                break;
+            }
+            for(int i = 0; i < spriteCount; i++)
+            {
+                bool swap = mask[i / 32] & (1u << i % 32);
+                child0[i] = swap ? father[i] : mother[i];
+                child1[i] = swap ? mother[i] : father[i];
+            }
+            break;
+        }
+        case CROSSOVER_REGION:
+        {
+            Vector2 bounds = positionBounds(packer);
+            Vector2 p0 = {.x = pcg32_boundedrand(bounds.x), .y = pcg32_boundedrand(bounds.y)};
+            Vector2 p1 = {.x = pcg32_boundedrand(bounds.x), .y = pcg32_boundedrand(bounds.y)};
+            Vector2 min = vector2_min(p0, p1);
+            Vector2 max = vector2_max(p0, p1);
+            bool paged = isPaged(packer);
+            int page = paged ? pcg32_boundedrand(packer->settings.pageCount) : 0;
+            Sprite *sprites = packer->sprites;
+            for(int i = 0; i < spriteCount; i++)
+            {
+                child0[i] = inRegion(sprites, &mother[i], min, max, paged, page) ? 
+                            mother[i] : father[i];
+                child1[i] = inRegion(sprites, &father[i], min, max, paged, page) ? 
+                            father[i] : mother[i];
+            }
+            break;
+        }
+        case CROSSOVER_ORDER:
+            randomSegment(segment, spriteCount);
+            orderCrossover(child0, mother, father, segment, spriteCount, scratch);
+            orderCrossover(child1, father, mother, segment, spriteCount, scratch);
+            break;
+        case CROSSOVER_PMX:
+        {
+            int *fatherRank = scratch + spriteCount;
+            randomSegment(segment, spriteCount);
+            rankSprites(mother, spriteCount, motherRank);
+            rankSprites(father, spriteCount, fatherRank);
+            pmxCrossover(child0, mother, father, segment, spriteCount, motherRank, scratch);
+            pmxCrossover(child1, father, mother, segment, spriteCount, fatherRank, scratch);
+            break;
+        }
+        case CROSSOVER_CYCLE:
+            rankSprites(mother, spriteCount, motherRank);
+            cycleCrossover(child0, child1, mother, father, spriteCount, motherRank, scratch);
+            break;
+        case CROSSOVER_EDGE:
+            edgeCrossover(child0, mother, mother, father, spriteCount, scratch);
+            edgeCrossover(child1, father, mother, father, spriteCount, scratch);
+            break;
+        default:
+            assert(false);
+    }
+    if(VARIANT_ENCODING == MOV_DIRECTION)
+    {
+        testIndecies(child0, spriteCount, scratch);
+        testIndecies(child1, spriteCount, scratch);
+    }
+    PROFILE_END(PHASE_CROSSOVER);
+}
+
+#endif
+
+#undef VARIANT_ALIGN_UP
+#undef VARIANT_ENCODING
+#undef VARIANT_DISABLE_ERROR_TERM
+#undef VARIANT_ALIGNED
+#undef VARIANT
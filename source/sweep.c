@@ -0,0 +1,105 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "sweep.h"
+
+// qsort has no context argument, sweeps only run on the main thread
+static double *compareCosts;
+
+static int compareCostDesc(const void *a, const void *b)
+{
+    int first = *(int *)a;
+    int second = *(int *)b;
+    if(compareCosts[first] != compareCosts[second])
+        return compareCosts[first] < compareCosts[second] ? 1 : -1;
+    return first - second;
+}
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+void sweep_run(int jobCount, int processCount, double *costs,
+               SweepJob job, SweepFinished finished, void *data)
+{
+    int *order = malloc(jobCount * sizeof (int));
+    for(int i = 0; i < jobCount; i++)
+        order[i] = i;
+    if(costs)
+    {
+        compareCosts = costs;
+        qsort(order, jobCount, sizeof (int), compareCostDesc);
+    }
+    if(processCount <= 1)
+    {
+        for(int i = 0; i < jobCount; i++)
+        {
+            double start = now();
+            RunResult result = job(data, order[i]);
+            if(finished)
+                finished(data, order[i], result, now() - start);
+        }
+        free(order);
+        return;
+    }
+    // Written by the children, read by the parent after they exited
+    RunResult *results = mmap(NULL, jobCount * sizeof (RunResult), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(results != MAP_FAILED);
+    pid_t *processes = malloc(jobCount * sizeof (pid_t));
+    double *starts = malloc(jobCount * sizeof (double));
+    int next = 0;
+    int running = 0;
+    while(next < jobCount || running > 0)
+    {
+        if(running < processCount && next < jobCount)
+        {
+            int index = order[next++];
+            results[index] = (RunResult){.bestScore = INT_MAX};
+            // Buffered output would be written by the parent and the child
+            fflush(NULL);
+            pid_t process = fork();
+            assert(process >= 0);
+            if(process == 0)
+            {
+                results[index] = job(data, index);
+                fflush(NULL);
+                _exit(0);
+            }
+            processes[index] = process;
+            starts[index] = now();
+            running++;
+            continue;
+        }
+        int status;
+        pid_t process = waitpid(-1, &status, 0);
+        assert(process > 0);
+        int index = -1;
+        for(int i = 0; i < next && index < 0; i++)
+            if(processes[order[i]] == process)
+                index = order[i];
+        if(index < 0)
+            continue;
+        processes[index] = 0;
+        running--;
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "sweep: job %i failed\n", index);
+            results[index] = (RunResult){.bestScore = INT_MAX};
+        }
+        if(finished)
+            finished(data, index, results[index], now() - starts[index]);
+    }
+    munmap(results, jobCount * sizeof (RunResult));
+    free(processes);
+    free(starts);
+    free(order);
+}
@@ -0,0 +1,18 @@
+#ifndef _SWEEP_H
+#define _SWEEP_H
+
+#include "problem.h"
+
+// Runs job(data, index) for every index in [0, jobCount) in forked worker
+// processes, at most processCount at a time. Jobs start in order of
+// decreasing cost, so the longest ones don't end up last. The RunResult of a
+// job comes back through shared memory, a job that crashed reports INT_MAX.
+// finished is called on the parent in completion order and may be NULL.
+// processCount <= 1 runs everything in the calling process.
+typedef RunResult (*SweepJob)(void *data, int index);
+typedef void (*SweepFinished)(void *data, int index, RunResult result, double seconds);
+
+void sweep_run(int jobCount, int processCount, double *costs,
+               SweepJob job, SweepFinished finished, void *data);
+
+#endif